@@ -0,0 +1,228 @@
+//
+//  bench.cpp
+//  engine
+//
+//  Created by Gareth George on 1/9/17.
+//  Copyright © 2017 Gareth George. All rights reserved.
+//
+
+#include <iostream>
+#include <ctime>
+#include <memory>
+
+#include "bench.hpp"
+#include "tests.hpp"
+#include "intelligence.hpp"
+#include "bitboard.hpp"
+#include "board.hpp"
+#include "nnue.hpp"
+
+static uint64_t perft(Board& board, Move::TMoveScratchStack& stack, TTeam team, int depth) {
+    if (depth == 0) return 1;
+    uint64_t count = 0;
+    Board::MoveList moves;
+    board.generateMoves(moves, team);
+    for (auto move : moves) {
+        move.make(board, stack);
+        count += perft(board, stack, -team, depth - 1);
+        move.unmake(board, stack);
+    }
+    return count;
+}
+
+// same walk as perft but every child is a fresh copy of its parent, nothing is unmade
+static uint64_t perftCopyMake(const Board& board, TTeam team, int depth) {
+    if (depth == 0) return 1;
+    uint64_t count = 0;
+    Board::MoveList moves;
+    board.generateMoves(moves, team);
+    for (auto move : moves) {
+        Board child(board);
+        NullStateStack scratch;
+        move.make(child, scratch);
+        count += perftCopyMake(child, -team, depth - 1);
+    }
+    return count;
+}
+
+/*
+ times every slider backend this cpu can run. the start position boxes the
+ sliders in, so the backends are timed on kiwipete's open middlegame and on
+ a bare lookup loop over every square and a spread of occupancies.
+ */
+static void benchSliderBackends() {
+    const SliderBackend selected = sliderBackend;
+    std::cout << "Slider backend selected at startup: " << sliderBackendName(selected) << std::endl;
+
+    // blockers of a few real positions, all of them seen from every square
+    const char* positions[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - -",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -"
+    };
+    TBitboard occupancies[4];
+    for (int i = 0; i < 4; ++i) {
+        Board board;
+        board.loadBoardFromFEN(positions[i]);
+        occupancies[i] = board.getOccupied();
+    }
+
+    for (SliderBackend backend : {SliderBackend::PEXT, SliderBackend::MAGIC, SliderBackend::PORTABLE}) {
+        if (!setSliderBackend(backend)) {
+            std::cout << "\t" << sliderBackendName(backend) << ": not supported" << std::endl;
+            continue ;
+        }
+
+        Board board;
+        Move::TMoveScratchStack stack;
+        board.loadBoardFromFEN(positions[0]);
+
+        clock_t begin_time = clock();
+        const uint64_t nodes = perft(board, stack, 1, 4);
+        double seconds = double(clock() - begin_time) / CLOCKS_PER_SEC;
+
+        const int rounds = 20000;
+        TBitboard checksum = 0;
+        begin_time = clock();
+        for (int r = 0; r < rounds; ++r) {
+            for (TBitboard occupied : occupancies) {
+                for (int square = 0; square < BOARD_SIZE; ++square)
+                    checksum += bishopAttacks(square, occupied ^ r) ^ rookAttacks(square, occupied ^ r);
+            }
+        }
+        const double lookupSeconds = double(clock() - begin_time) / CLOCKS_PER_SEC;
+
+        std::cout << "\t" << sliderBackendName(backend) << ": kiwipete perft 4 = " << nodes << " nodes in "
+                  << seconds << " seconds (" << uint64_t(nodes / seconds) << " nodes/sec), "
+                  << lookupSeconds * 1e9 / (rounds * 4 * BOARD_SIZE * 2) << " ns per lookup (checksum "
+                  << (checksum & 0xffff) << ")" << std::endl;
+    }
+
+    setSliderBackend(selected);
+}
+
+// compares make/unmake against copy-make on the same perft
+static void benchMakeModes() {
+    std::cout << "Board is " << sizeof(Board) << " bytes" << std::endl;
+
+    Board board;
+    board.setupBoard();
+
+    Move::TMoveScratchStack stack;
+    clock_t begin_time = clock();
+    uint64_t nodes = perft(board, stack, 1, 5);
+    double seconds = double(clock() - begin_time) / CLOCKS_PER_SEC;
+    std::cout << "	make/unmake: perft 5 = " << nodes << " nodes in " << seconds << " seconds ("
+              << uint64_t(nodes / seconds) << " nodes/sec)" << std::endl;
+
+    begin_time = clock();
+    nodes = perftCopyMake(board, 1, 5);
+    seconds = double(clock() - begin_time) / CLOCKS_PER_SEC;
+    std::cout << "	copy-make: perft 5 = " << nodes << " nodes in " << seconds << " seconds ("
+              << uint64_t(nodes / seconds) << " nodes/sec)" << std::endl;
+}
+
+// average cost of the attack queries over every square of a busy middlegame
+static void benchAttackQueries() {
+    Board board;
+    board.loadBoardFromFEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
+
+    const int rounds = 100000;
+    int hits = 0;
+    const clock_t begin_time = clock();
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < BOARD_SIZE; ++i) {
+            hits += board.isAttacked(mailbox64[i], r & 1 ? 1 : -1);
+            hits += board.isPinned(mailbox64[i], r & 1 ? 1 : -1);
+        }
+    }
+    const double seconds = double(clock() - begin_time) / CLOCKS_PER_SEC;
+    std::cout << "Attack queries: " << seconds * 1e9 / (rounds * BOARD_SIZE * 2) << " ns per call ("
+              << hits << " hits)" << std::endl;
+}
+
+// what keeping the accumulator costs make/unmake, and network against hand written evaluation per kernel backend
+static void benchNetwork() {
+    // a random network times the same as a trained one
+    std::unique_ptr<Network> network(new Network());
+    network->randomize(11);
+    Accumulator acc;
+    acc.network = network.get();
+
+    Board board;
+    board.loadBoardFromFEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
+    Move::TMoveScratchStack stack;
+    ScoreFunction score;
+    const int rounds = 200000;
+
+    clock_t begin_time = clock();
+    uint64_t nodes = perft(board, stack, 1, 4);
+    double seconds = double(clock() - begin_time) / CLOCKS_PER_SEC;
+    std::cout << "Network: perft 4 without accumulator " << uint64_t(nodes / seconds) << " nodes/sec" << std::endl;
+
+    TScore total = 0;
+    begin_time = clock();
+    for (int r = 0; r < rounds; ++r)
+        total += score(board);
+    seconds = double(clock() - begin_time) / CLOCKS_PER_SEC;
+    std::cout << "\thand written eval: " << seconds * 1e9 / rounds << " ns per call" << std::endl;
+
+    const NNUEBackend selected = nnueBackend;
+    for (NNUEBackend backend : {NNUEBackend::AVX2, NNUEBackend::SSSE3, NNUEBackend::SCALAR}) {
+        if (!setNNUEBackend(backend)) {
+            std::cout << "\t" << nnueBackendName(backend) << ": not supported" << std::endl;
+            continue ;
+        }
+        board.attachAccumulator(&acc);
+
+        begin_time = clock();
+        nodes = perft(board, stack, 1, 4);
+        const double perftSeconds = double(clock() - begin_time) / CLOCKS_PER_SEC;
+
+        begin_time = clock();
+        for (int r = 0; r < rounds; ++r)
+            total += score(board);
+        seconds = double(clock() - begin_time) / CLOCKS_PER_SEC;
+
+        std::cout << "\t" << nnueBackendName(backend) << ": perft 4 with accumulator " << uint64_t(nodes / perftSeconds)
+                  << " nodes/sec, eval " << seconds * 1e9 / rounds << " ns per call" << std::endl;
+        board.attachAccumulator(nullptr);
+    }
+    setNNUEBackend(selected);
+    std::cout << "\t(checksum " << total << ")" << std::endl;
+}
+
+// runs one timed search from the opening and reports heap traffic during it
+static void benchSearch() {
+    Board board;
+    board.setupBoard();
+    AIPlayer player(2);
+    Move result;
+
+#ifdef SEARCH_COPY_MAKE
+    std::cout << "Search mode: copy-make" << std::endl;
+#else
+    std::cout << "Search mode: make/unmake" << std::endl;
+#endif
+    defaultNetwork(); // reads CHESS_NNUE up front so loading it isn't counted
+    const size_t before = allocationCount;
+    player.pickBestMove(board, 1, &result);
+    std::cout << "Allocations during search: " << allocationCount - before << std::endl;
+
+    const EvalCache& cache = player.getEvalCache();
+    std::cout << "Eval cache: " << cache.hits << " hits of " << cache.probes << " probes ("
+              << (cache.probes ? 100.0 * cache.hits / cache.probes : 0.0) << "%)" << std::endl;
+
+    const ScoreFunction& score = player.getScoreFunction();
+    std::cout << "Lazy eval: " << score.lazyExits << " early exits of " << score.evaluations << " evaluations ("
+              << (score.evaluations ? 100.0 * score.lazyExits / score.evaluations : 0.0) << "%)" << std::endl;
+}
+
+void runBench() {
+    benchSliderBackends();
+    benchMakeModes();
+    benchAttackQueries();
+    benchNetwork();
+    benchSearch();
+}
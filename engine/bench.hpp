@@ -0,0 +1,14 @@
+//
+//  bench.hpp
+//  engine
+//
+//  Created by Gareth George on 1/9/17.
+//  Copyright © 2017 Gareth George. All rights reserved.
+//
+
+#ifndef bench_hpp
+#define bench_hpp
+
+extern void runBench();
+
+#endif /* bench_hpp */
@@ -0,0 +1,311 @@
+//
+//  bitboard.cpp
+//  engine
+//
+//  Created by Gareth George on 1/8/17.
+//  Copyright © 2017 Gareth George. All rights reserved.
+//
+
+#include <random>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define HAS_X86_PEXT
+#endif
+
+#include "bitboard.hpp"
+
+Magic bishopMagics[BOARD_SIZE];
+Magic rookMagics[BOARD_SIZE];
+
+// sizes are the sum over all squares of 2^(relevant occupancy bits)
+static TBitboard bishopAttackTable[5248];
+static TBitboard rookAttackTable[102400];
+
+SliderBackend sliderBackend = SliderBackend::MAGIC;
+
+/**
+ walks each ray out from square until it runs off the board or hits a blocker
+ */
+static constexpr TBitboard slidingAttacks(int square, TBitboard occupied, const int (*directions)[2]) {
+    TBitboard attacks = 0;
+    for (int i = 0; i < 4; ++i) {
+        int row = square / BOARD_DIM + directions[i][0];
+        int col = square % BOARD_DIM + directions[i][1];
+        while (row >= 0 && row < BOARD_DIM && col >= 0 && col < BOARD_DIM) {
+            const TBitboard bb = squareBit(row * BOARD_DIM + col);
+            attacks |= bb;
+            if (occupied & bb)
+                break ;
+            row += directions[i][0];
+            col += directions[i][1];
+        }
+    }
+    return attacks;
+}
+
+static constexpr int bishopDirections[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+static constexpr int rookDirections[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+/*
+ compile time tables
+ */
+
+// squares reached by single steps, the knight and king tables
+static constexpr TSquareBitboards generateStepAttacks(const int (*steps)[2]) {
+    TSquareBitboards table = {};
+    for (int square = 0; square < BOARD_SIZE; ++square) {
+        for (int i = 0; i < 8; ++i) {
+            const int row = square / BOARD_DIM + steps[i][0];
+            const int col = square % BOARD_DIM + steps[i][1];
+            if (row >= 0 && row < BOARD_DIM && col >= 0 && col < BOARD_DIM)
+                table[square] |= squareBit(row * BOARD_DIM + col);
+        }
+    }
+    return table;
+}
+
+static constexpr LookupTable<TSquareBitboards, 2> generatePawnAttacks() {
+    LookupTable<TSquareBitboards, 2> table = {};
+    for (int square = 0; square < BOARD_SIZE; ++square) {
+        const TBitboard bb = squareBit(square);
+        table[0][square] = shiftNorthEast(bb) | shiftNorthWest(bb);
+        table[1][square] = shiftSouthEast(bb) | shiftSouthWest(bb);
+    }
+    return table;
+}
+
+// between when between is set, otherwise the whole line
+static constexpr LookupTable<TSquareBitboards, BOARD_SIZE> generateLines(bool between) {
+    LookupTable<TSquareBitboards, BOARD_SIZE> table = {};
+    const int (*directionSets[2])[2] = {bishopDirections, rookDirections};
+    for (int d = 0; d < 2; ++d) {
+        for (int s1 = 0; s1 < BOARD_SIZE; ++s1) {
+            const TBitboard rays = slidingAttacks(s1, 0, directionSets[d]);
+            for (int s2 = 0; s2 < BOARD_SIZE; ++s2) {
+                if (s1 == s2 || !(rays & squareBit(s2)))
+                    continue ;
+                if (between)
+                    table[s1][s2] = slidingAttacks(s1, squareBit(s2), directionSets[d]) & slidingAttacks(s2, squareBit(s1), directionSets[d]);
+                else
+                    table[s1][s2] = (rays & slidingAttacks(s2, 0, directionSets[d])) | squareBit(s1) | squareBit(s2);
+            }
+        }
+    }
+    return table;
+}
+
+static constexpr int knightSteps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+static constexpr int kingSteps[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+
+constexpr TSquareBitboards knightAttackTable = generateStepAttacks(knightSteps);
+constexpr TSquareBitboards kingAttackTable = generateStepAttacks(kingSteps);
+constexpr LookupTable<TSquareBitboards, 2> pawnAttackTable = generatePawnAttacks();
+constexpr LookupTable<TSquareBitboards, BOARD_SIZE> betweenTable = generateLines(true);
+constexpr LookupTable<TSquareBitboards, BOARD_SIZE> lineTable = generateLines(false);
+
+TBitboard portableBishopAttacks(int square, TBitboard occupied) {
+    return slidingAttacks(square, occupied, bishopDirections);
+}
+
+TBitboard portableRookAttacks(int square, TBitboard occupied) {
+    return slidingAttacks(square, occupied, rookDirections);
+}
+
+/*
+ PEXT kernels, these are compiled for BMI2 regardless of the build flags and
+ must only be called once sliderBackendSupported(PEXT) has been checked.
+ */
+#ifdef HAS_X86_PEXT
+__attribute__((target("bmi2"))) static unsigned pextIndex(TBitboard occupied, TBitboard mask) {
+    return unsigned(_pext_u64(occupied, mask));
+}
+
+__attribute__((target("bmi2"))) TBitboard pextBishopAttacks(int square, TBitboard occupied) {
+    const Magic& m = bishopMagics[square];
+    return m.attacks[_pext_u64(occupied, m.mask)];
+}
+
+__attribute__((target("bmi2"))) TBitboard pextRookAttacks(int square, TBitboard occupied) {
+    const Magic& m = rookMagics[square];
+    return m.attacks[_pext_u64(occupied, m.mask)];
+}
+#else
+static unsigned pextIndex(TBitboard occupied, TBitboard mask) {
+    assert(0);
+    return 0;
+}
+
+TBitboard pextBishopAttacks(int square, TBitboard occupied) {
+    return portableBishopAttacks(square, occupied);
+}
+
+TBitboard pextRookAttacks(int square, TBitboard occupied) {
+    return portableRookAttacks(square, occupied);
+}
+#endif
+
+/**
+ refills the attack tables in the order the backend indexes them. the magic
+ and PEXT layouts share the same storage since only one is live at a time.
+ */
+static void fillSliderTable(Magic* magics, const int (*directions)[2], SliderBackend backend) {
+    for (int square = 0; square < BOARD_SIZE; ++square) {
+        Magic& m = magics[square];
+        TBitboard subset = 0;
+        do {
+            const unsigned idx = backend == SliderBackend::PEXT ? pextIndex(subset, m.mask) : m.index(subset);
+            m.attacks[idx] = slidingAttacks(square, subset, directions);
+            subset = (subset - m.mask) & m.mask;
+        } while (subset);
+    }
+}
+
+/**
+ finds a magic for every square by trial and error and fills in the attack
+ tables. the seed is fixed so startup is deterministic, this takes a few ms.
+ */
+static void initMagics(Magic* magics, TBitboard* table, const int (*directions)[2]) {
+    std::mt19937_64 rng(728);
+    TBitboard occupancy[4096];
+    TBitboard reference[4096];
+    int epoch[4096] = {0};
+    int attempt = 0;
+
+    for (int square = 0; square < BOARD_SIZE; ++square) {
+        // board edges never block a ray so they are left out of the mask
+        const TBitboard edges = ((kRank1 | kRank8) & ~(kRank1 << (8 * (square / BOARD_DIM)))) |
+                                ((kFileA | kFileH) & ~(kFileA << (square % BOARD_DIM)));
+
+        Magic& m = magics[square];
+        m.mask = slidingAttacks(square, 0, directions) & ~edges;
+        m.shift = 64 - popCount(m.mask);
+        m.attacks = square == 0 ? table : magics[square - 1].attacks + (1 << (64 - magics[square - 1].shift));
+
+        // enumerate every subset of the mask (carry rippler) with its attack set
+        int size = 0;
+        TBitboard subset = 0;
+        do {
+            occupancy[size] = subset;
+            reference[size] = slidingAttacks(square, subset, directions);
+            size++;
+            subset = (subset - m.mask) & m.mask;
+        } while (subset);
+
+        for (int i = 0; i < size; ) {
+            // sparse candidates make for better magics
+            do {
+                m.magic = rng() & rng() & rng();
+            } while (popCount((m.mask * m.magic) >> 56) < 6);
+
+            attempt++;
+            for (i = 0; i < size; ++i) {
+                const unsigned idx = m.index(occupancy[i]);
+                if (epoch[idx] < attempt) {
+                    epoch[idx] = attempt;
+                    m.attacks[idx] = reference[i];
+                } else if (m.attacks[idx] != reference[i]) {
+                    break ; // destructive collision, try another magic
+                }
+            }
+        }
+    }
+}
+
+/**
+ magics are searched for at startup, only the slider tables are built at runtime
+ */
+struct __PopulateAttackTables {
+    __PopulateAttackTables() {
+        initMagics(bishopMagics, bishopAttackTable, bishopDirections);
+        initMagics(rookMagics, rookAttackTable, rookDirections);
+    }
+};
+
+__PopulateAttackTables __populateAttackTables;
+
+/*
+ backend selection
+ */
+
+const char* sliderBackendName(SliderBackend backend) {
+    switch (backend) {
+        case SliderBackend::PEXT: return "pext";
+        case SliderBackend::MAGIC: return "magic";
+        case SliderBackend::PORTABLE: return "portable";
+    }
+    return "?";
+}
+
+bool sliderBackendSupported(SliderBackend backend) {
+#ifdef HAS_X86_PEXT
+    if (backend == SliderBackend::PEXT)
+        return __builtin_cpu_supports("bmi2");
+#else
+    if (backend == SliderBackend::PEXT)
+        return false;
+#endif
+    return true;
+}
+
+// AMD before Zen 3 implements PEXT in microcode, which is far slower than a magic multiply
+static bool hasSlowPext() {
+#ifdef HAS_X86_PEXT
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx))
+        return true;
+    char vendor[13];
+    memcpy(vendor + 0, &ebx, 4);
+    memcpy(vendor + 4, &edx, 4);
+    memcpy(vendor + 8, &ecx, 4);
+    vendor[12] = 0;
+    if (strcmp(vendor, "AuthenticAMD") != 0)
+        return false;
+
+    __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+    unsigned family = (eax >> 8) & 0xF;
+    if (family == 0xF)
+        family += (eax >> 20) & 0xFF;
+    return family < 0x19;
+#else
+    return true;
+#endif
+}
+
+SliderBackend detectSliderBackend() {
+    // CHESS_SLIDERS=pext|magic|portable overrides the cpuid based choice
+    const char* forced = getenv("CHESS_SLIDERS");
+    if (forced != nullptr) {
+        for (SliderBackend backend : {SliderBackend::PEXT, SliderBackend::MAGIC, SliderBackend::PORTABLE}) {
+            if (strcmp(forced, sliderBackendName(backend)) == 0 && sliderBackendSupported(backend))
+                return backend;
+        }
+    }
+
+    if (sliderBackendSupported(SliderBackend::PEXT) && !hasSlowPext())
+        return SliderBackend::PEXT;
+    return SliderBackend::MAGIC;
+}
+
+bool setSliderBackend(SliderBackend backend) {
+    if (!sliderBackendSupported(backend))
+        return false;
+    if (backend != SliderBackend::PORTABLE) {
+        fillSliderTable(bishopMagics, bishopDirections, backend);
+        fillSliderTable(rookMagics, rookDirections, backend);
+    }
+    sliderBackend = backend;
+    return true;
+}
+
+struct __SelectSliderBackend {
+    __SelectSliderBackend() {
+        setSliderBackend(detectSliderBackend());
+    }
+};
+
+__SelectSliderBackend __selectSliderBackend;
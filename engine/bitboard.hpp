@@ -0,0 +1,145 @@
+//
+//  bitboard.hpp
+//  engine
+//
+//  Created by Gareth George on 1/8/17.
+//  Copyright © 2017 Gareth George. All rights reserved.
+//
+
+#ifndef bitboard_hpp
+#define bitboard_hpp
+
+#include <stdint.h>
+
+#include "constants.hpp"
+
+/**
+ 64 bit square sets. bit i corresponds to the 64 square index i (the same
+ indexing used by mailbox64), a1 = 0, h1 = 7, a8 = 56, h8 = 63.
+ */
+typedef uint64_t TBitboard;
+
+constexpr TBitboard kFileA = 0x0101010101010101ULL;
+constexpr TBitboard kFileH = kFileA << 7;
+constexpr TBitboard kRank1 = 0xFFULL;
+constexpr TBitboard kRank2 = kRank1 << (8 * 1);
+constexpr TBitboard kRank3 = kRank1 << (8 * 2);
+constexpr TBitboard kRank6 = kRank1 << (8 * 5);
+constexpr TBitboard kRank7 = kRank1 << (8 * 6);
+constexpr TBitboard kRank8 = kRank1 << (8 * 7);
+
+// one bitboard per square. the leaper and line tables are generated at compile time in bitboard.cpp
+typedef LookupTable<TBitboard, BOARD_SIZE> TSquareBitboards;
+
+extern const TSquareBitboards knightAttackTable;
+extern const TSquareBitboards kingAttackTable;
+extern const LookupTable<TSquareBitboards, 2> pawnAttackTable; // [white, black][square]
+
+// squares strictly between two squares on a shared rank, file or diagonal, otherwise empty
+extern const LookupTable<TSquareBitboards, BOARD_SIZE> betweenTable;
+// the whole rank, file or diagonal through two squares, otherwise empty
+extern const LookupTable<TSquareBitboards, BOARD_SIZE> lineTable;
+
+constexpr TBitboard squareBit(int square) {
+    return 1ULL << square;
+}
+
+inline int popCount(TBitboard bb) {
+    return __builtin_popcountll(bb);
+}
+
+// index of the least significant set bit, bb must be non zero
+inline int bitScanForward(TBitboard bb) {
+    return __builtin_ctzll(bb);
+}
+
+// returns and clears the least significant set bit, bb must be non zero
+inline int popLsb(TBitboard& bb) {
+    const int square = bitScanForward(bb);
+    bb &= bb - 1;
+    return square;
+}
+
+constexpr TBitboard shiftNorth(TBitboard bb) { return bb << 8; }
+constexpr TBitboard shiftSouth(TBitboard bb) { return bb >> 8; }
+constexpr TBitboard shiftEast(TBitboard bb) { return (bb & ~kFileH) << 1; }
+constexpr TBitboard shiftWest(TBitboard bb) { return (bb & ~kFileA) >> 1; }
+constexpr TBitboard shiftNorthEast(TBitboard bb) { return (bb & ~kFileH) << 9; }
+constexpr TBitboard shiftNorthWest(TBitboard bb) { return (bb & ~kFileA) << 7; }
+constexpr TBitboard shiftSouthEast(TBitboard bb) { return (bb & ~kFileH) >> 7; }
+constexpr TBitboard shiftSouthWest(TBitboard bb) { return (bb & ~kFileA) >> 9; }
+
+/**
+ magic bitboard entry for one square. the relevant occupancy bits (the ray
+ squares, excluding board edges) are hashed by multiplying with a magic number
+ and keeping the top bits, which index a table holding the full attack set.
+ */
+struct Magic {
+    TBitboard mask;
+    TBitboard magic;
+    TBitboard* attacks;
+    unsigned shift;
+
+    inline unsigned index(TBitboard occupied) const {
+        return unsigned(((occupied & mask) * magic) >> shift);
+    }
+};
+
+extern Magic bishopMagics[BOARD_SIZE];
+extern Magic rookMagics[BOARD_SIZE];
+
+/**
+ slider attack kernels. which one is used is picked once at startup from
+ cpuid: PEXT where BMI2 is fast, magic multiplication otherwise. the portable
+ ray walk needs no tables and is kept as a reference and for benchmarking.
+ */
+enum class SliderBackend : uint8_t {
+    PEXT,
+    MAGIC,
+    PORTABLE
+};
+
+extern SliderBackend sliderBackend;
+
+extern const char* sliderBackendName(SliderBackend backend);
+extern bool sliderBackendSupported(SliderBackend backend);
+extern SliderBackend detectSliderBackend();
+extern bool setSliderBackend(SliderBackend backend); // rebuilds the attack tables for the backend
+
+extern TBitboard pextBishopAttacks(int square, TBitboard occupied);
+extern TBitboard pextRookAttacks(int square, TBitboard occupied);
+extern TBitboard portableBishopAttacks(int square, TBitboard occupied);
+extern TBitboard portableRookAttacks(int square, TBitboard occupied);
+
+// slider attacks from square given the occupied set, blockers are included in the result
+inline TBitboard bishopAttacks(int square, TBitboard occupied) {
+    switch (sliderBackend) {
+        case SliderBackend::MAGIC: {
+            const Magic& m = bishopMagics[square];
+            return m.attacks[m.index(occupied)];
+        }
+        case SliderBackend::PEXT:
+            return pextBishopAttacks(square, occupied);
+        default:
+            return portableBishopAttacks(square, occupied);
+    }
+}
+
+inline TBitboard rookAttacks(int square, TBitboard occupied) {
+    switch (sliderBackend) {
+        case SliderBackend::MAGIC: {
+            const Magic& m = rookMagics[square];
+            return m.attacks[m.index(occupied)];
+        }
+        case SliderBackend::PEXT:
+            return pextRookAttacks(square, occupied);
+        default:
+            return portableRookAttacks(square, occupied);
+    }
+}
+
+inline TBitboard queenAttacks(int square, TBitboard occupied) {
+    return bishopAttacks(square, occupied) | rookAttacks(square, occupied);
+}
+
+#endif /* bitboard_hpp */
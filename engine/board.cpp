@@ -8,103 +8,55 @@
 
 #include <sstream>
 #include <iostream>
-#include <random>
 
 #include "board.hpp"
 
-const int mailbox[120] = {
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 1
-    -1,  0,  1,  2,  3,  4,  5,  6,  7, -1, // 2
-    -1,  8,  9, 10, 11, 12, 13, 14, 15, -1, // 3
-    -1, 16, 17, 18, 19, 20, 21, 22, 23, -1, // 4
-    -1, 24, 25, 26, 27, 28, 29, 30, 31, -1, // 5
-    -1, 32, 33, 34, 35, 36, 37, 38, 39, -1, // 6
-    -1, 40, 41, 42, 43, 44, 45, 46, 47, -1, // 7
-    -1, 48, 49, 50, 51, 52, 53, 54, 55, -1, // 8
-    -1, 56, 57, 58, 59, 60, 61, 62, 63, -1, // 9
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 10
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1  // 11
-};
-
-const int mailbox64[64] = {
-    21, 22, 23, 24, 25, 26, 27, 28,
-    31, 32, 33, 34, 35, 36, 37, 38,
-    41, 42, 43, 44, 45, 46, 47, 48,
-    51, 52, 53, 54, 55, 56, 57, 58,
-    61, 62, 63, 64, 65, 66, 67, 68,
-    71, 72, 73, 74, 75, 76, 77, 78,
-    81, 82, 83, 84, 85, 86, 87, 88,
-    91, 92, 93, 94, 95, 96, 97, 98
-};
-
-int mirror64[64];
-
-uint64_t pieceHashTable[64 * 16];
-uint64_t flagHashTable[256];
-
-struct __PopulateTables {
-    __PopulateTables() {
-        /* populate the hash tables */
-        std::mt19937_64 e2(5489u); // known seed for consistent hashing
-        std::uniform_int_distribution<long long int> dist(std::llround(std::pow(2,61)), std::llround(std::pow(2,62)));
-
-        // initialize piece hashes
-        for (int i = 0; i < 64 * 16; ++i)
-            pieceHashTable[i] = dist(e2);
+// splitmix64, a constexpr PRNG with a fixed seed so the keys are the same every build
+static constexpr uint64_t nextRandom(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
 
-        // initialize flag hashes
-        for (int i = 0; i < 256; ++i)
-            flagHashTable[i] = dist(e2);
+template<int N>
+static constexpr LookupTable<uint64_t, N> generateHashKeys(uint64_t seed) {
+    LookupTable<uint64_t, N> table = {};
+    for (int i = 0; i < N; ++i)
+        table[i] = nextRandom(seed);
+    return table;
+}
 
-        /* populate the mirror tables */
-        for (int i = 0; i < 64; ++i) {
-            mirror64[i] = (7 - i / 8) * 8 + i % 8;
-        }
-    }
+constexpr LookupTable<uint64_t, 64 * 16> pieceHashTable = generateHashKeys<64 * 16>(5489u);
+constexpr LookupTable<uint64_t, 256> flagHashTable = generateHashKeys<256>(728u);
+
+const TBoardFlags castleRightsMask[64] = {
+    (TBoardFlags)~kFlagCastleWhiteQueen, 0xFF, 0xFF, 0xFF, (TBoardFlags)~(kFlagCastleWhiteKing | kFlagCastleWhiteQueen), 0xFF, 0xFF, (TBoardFlags)~kFlagCastleWhiteKing,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    (TBoardFlags)~kFlagCastleBlackQueen, 0xFF, 0xFF, 0xFF, (TBoardFlags)~(kFlagCastleBlackKing | kFlagCastleBlackQueen), 0xFF, 0xFF, (TBoardFlags)~kFlagCastleBlackKing
 };
 
-__PopulateTables __populateTables;
-
-
-
 Board::Board() {
     hash = flagHashTable[flags];
-    for (int i = 0; i < MAILBOX_SIZE; ++i) {
-        if (mailbox[i] < 0)
-            pieces[i] = OUT_OF_BOUNDS;
-        else
-            pieces[i] = 0;
-    }
-}
-
-Board::Board(const Board& board) : Board() {
-    flags = board.flags;
-    hash = flagHashTable[flags];
-
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        const int position = mailbox64[i];
-        setPiece(position, board[position]);
-    }
-
-#ifdef DEBUG_BOARD
-    assert(getZobristHash() == board.getZobristHash());
-    assert(getScore() == board.getScore());
-#endif
 }
 
 void Board::setupBoard() {
     // fen code for the initial board layout
-    loadBoardFromFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR");
+    loadBoardFromFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -");
 }
 
-void Board::loadBoardFromFEN(const char* FEN) {
+void Board::loadBoardFromFEN(const char* FEN, TTeam* toMove) {
     int row = 7;
     int col = 0;
     while (row >= 0) {
         if (*FEN == ' ' || *FEN == 0) break;
         if (*FEN >= '0' && *FEN <= '9') {
-            col += *FEN + 1;
+            col += *FEN - '0';
         } else if (*FEN == 'p') {
             setPiece(mailbox64[row * BOARD_DIM + col], -PIECE_PAWN);
             col++;
@@ -147,6 +99,42 @@ void Board::loadBoardFromFEN(const char* FEN) {
         }
         FEN++;
     }
+
+    /* side to move, castling rights and en passant square */
+    while (*FEN == ' ') FEN++;
+    if (toMove != nullptr)
+        *toMove = *FEN == 'b' ? -1 : 1;
+    const bool whiteToMove = *FEN != 'b';
+    if (*FEN) FEN++;
+
+    TBoardFlags newFlags = 0;
+    while (*FEN == ' ') FEN++;
+    for (; *FEN && *FEN != ' '; ++FEN) {
+        switch (*FEN) {
+            case 'K': newFlags |= kFlagCastleWhiteKing; break ;
+            case 'Q': newFlags |= kFlagCastleWhiteQueen; break ;
+            case 'k': newFlags |= kFlagCastleBlackKing; break ;
+            case 'q': newFlags |= kFlagCastleBlackQueen; break ;
+            default: break ;
+        }
+    }
+
+    while (*FEN == ' ') FEN++;
+    if (*FEN >= 'a' && *FEN <= 'h') {
+        // the pawn that double pushed sits one rank past the en passant square
+        const int file = *FEN - 'a';
+        newFlags |= enPassantFlags(mailbox64[(whiteToMove ? 4 : 3) * BOARD_DIM + file]);
+    }
+
+    setFlags(newFlags);
+}
+
+TBoardFlags Board::enPassantFlags(int position) const {
+    const TPiece pawn = pieces[mailbox[position]];
+    const TBitboard beside = shiftEast(squareBit(mailbox[position])) | shiftWest(squareBit(mailbox[position]));
+    if (pawn == 0 || !(beside & getPieces(PIECE_PAWN, -pawn)))
+        return 0;
+    return kFlagEnPassant | ((mailbox[position] % BOARD_DIM) << 4);
 }
 
 char pieceGetLetter(TPiece piece) {
@@ -181,222 +169,450 @@ std::string Board::toString() const {
  Move generation
  */
 
-struct CheckMoveLoud {
-    static inline bool can(const Board& board, int from, int to) {
-        const TPiece fromPiece = board[from];
-        const TPiece toPiece = board[to];
-        return toPiece != OUT_OF_BOUNDS && toPiece != 0 && (fromPiece < 0) != (toPiece < 0);
+// emits a move from `from` to every square in targets, captures are flagged LOUD
+inline void addMoves(int from, TBitboard targets, TBitboard enemy, Board::MoveList& moves) {
+    while (targets) {
+        const int to = popLsb(targets);
+        moves.push_back(Move((enemy & squareBit(to)) ? Move::Type::LOUD : Move::Type::QUIET, from, to));
     }
-};
+}
 
-struct CheckMoveQuiet {
-    static inline bool can(const Board& board, int from, int to) {
-        const TPiece toPiece = board[to];
-        return toPiece == 0;
+// emits pawn moves given the set of destination squares and the offset the pawns moved by
+inline void addPawnMoves(TBitboard targets, int offset, Move::Type type, Board::MoveList& moves) {
+    while (targets) {
+        const int to = popLsb(targets);
+        moves.push_back(Move(type, to - offset, to));
     }
-};
+}
 
-struct CheckMoveGeneric {
-    static inline bool can(const Board& board, int from, int to) {
-        const TPiece fromPiece = board[from];
-        const TPiece toPiece = board[to];
-        return toPiece != OUT_OF_BOUNDS && (toPiece == 0 || (fromPiece < 0) != (toPiece < 0));
-     }
-};
+inline void addPawnPromotions(TBitboard targets, int offset, Board::MoveList& moves) {
+    while (targets) {
+        const int to = popLsb(targets);
+        moves.push_back(Move(Move::Type::PAWN_PROMOTE, to - offset, to, PIECE_QUEEN));
+        moves.push_back(Move(Move::Type::PAWN_PROMOTE, to - offset, to, PIECE_KNIGHT));
+        moves.push_back(Move(Move::Type::PAWN_PROMOTE, to - offset, to, PIECE_ROOK));
+        moves.push_back(Move(Move::Type::PAWN_PROMOTE, to - offset, to, PIECE_BISHOP));
+    }
+}
+
+TBitboard Board::attackersTo(int square, TBitboard occupied) const {
+    return (pawnAttackTable[1][square] & getPieces(PIECE_PAWN, 1))
+         | (pawnAttackTable[0][square] & getPieces(PIECE_PAWN, -1))
+         | (knightAttackTable[square] & typeBitboards[PIECE_KNIGHT])
+         | (kingAttackTable[square] & typeBitboards[PIECE_KING])
+         | (bishopAttacks(square, occupied) & (typeBitboards[PIECE_BISHOP] | typeBitboards[PIECE_QUEEN]))
+         | (rookAttacks(square, occupied) & (typeBitboards[PIECE_ROOK] | typeBitboards[PIECE_QUEEN]));
+}
 
-struct AddMoveLoud {
-    static inline void addMove(const Board& board, int from, int to, Board::MoveList& moves) {
-        moves.push_back(Move(Move::Type::LOUD, from, to));
+Board::CheckInfo Board::getCheckInfo(TTeam player) const {
+    CheckInfo info;
+    const TBitboard king = getPieces(PIECE_KING, player);
+    if (king == 0)
+        return info; // only happens on hand built boards, nothing is pinned or in check
+
+    const TBitboard own = getTeamPieces(player);
+    const TBitboard enemy = getTeamPieces(-player);
+    const TBitboard occupied = own | enemy;
+    info.kingSquare = bitScanForward(king);
+    info.checkers = attackersTo(info.kingSquare, occupied) & enemy;
+
+    // enemy sliders that would see the king through exactly one of our pieces pin it
+    TBitboard snipers = ((rookAttacks(info.kingSquare, 0) & (typeBitboards[PIECE_ROOK] | typeBitboards[PIECE_QUEEN])) |
+                         (bishopAttacks(info.kingSquare, 0) & (typeBitboards[PIECE_BISHOP] | typeBitboards[PIECE_QUEEN]))) & enemy;
+    while (snipers) {
+        const TBitboard blockers = betweenTable[info.kingSquare][popLsb(snipers)] & occupied;
+        if (blockers != 0 && (blockers & (blockers - 1)) == 0 && (blockers & own))
+            info.pinned |= blockers;
     }
-};
+    return info;
+}
+
+/**
+ pawn moves for every pawn in pawns, destinations are limited to mask. all
+ pawns of a color are moved at once by shifting the whole set.
+ */
+template<Board::GenType Type, Color Player>
+void Board::generatePawnMoves(MoveList& moves, TBitboard pawns, TBitboard mask) const {
+    constexpr TTeam player = Player;
+    constexpr bool loud = Type != GenType::QUIETS;
+    constexpr bool quiet = Type != GenType::CAPTURES;
+
+    const TBitboard enemy = getTeamPieces(-player) & mask;
+    const TBitboard empty = ~getOccupied();
+
+    if (player > 0) {
+        const TBitboard promoting = pawns & kRank7;
+        const TBitboard rest = pawns & ~kRank7;
+
+        if (quiet) {
+            const TBitboard push = shiftNorth(rest) & empty;
+            addPawnMoves(push & mask, 8, Move::Type::QUIET, moves);
+            addPawnMoves(shiftNorth(push & kRank3) & empty & mask, 16, Move::Type::PAWN_DOUBLE, moves);
+        }
+        if (loud) {
+            addPawnMoves(shiftNorthEast(rest) & enemy, 9, Move::Type::LOUD, moves);
+            addPawnMoves(shiftNorthWest(rest) & enemy, 7, Move::Type::LOUD, moves);
+
+            addPawnPromotions(shiftNorthEast(promoting) & enemy, 9, moves);
+            addPawnPromotions(shiftNorthWest(promoting) & enemy, 7, moves);
+            addPawnPromotions(shiftNorth(promoting) & empty & mask, 8, moves);
+        }
+    } else {
+        const TBitboard promoting = pawns & kRank2;
+        const TBitboard rest = pawns & ~kRank2;
+
+        if (quiet) {
+            const TBitboard push = shiftSouth(rest) & empty;
+            addPawnMoves(push & mask, -8, Move::Type::QUIET, moves);
+            addPawnMoves(shiftSouth(push & kRank6) & empty & mask, -16, Move::Type::PAWN_DOUBLE, moves);
+        }
+        if (loud) {
+            addPawnMoves(shiftSouthEast(rest) & enemy, -7, Move::Type::LOUD, moves);
+            addPawnMoves(shiftSouthWest(rest) & enemy, -9, Move::Type::LOUD, moves);
 
-struct AddMoveQuiet {
-    static inline void addMove(const Board& board, int from, int to, Board::MoveList& moves) {
-        moves.push_back(Move(Move::Type::QUIET, from, to));
+            addPawnPromotions(shiftSouthEast(promoting) & enemy, -7, moves);
+            addPawnPromotions(shiftSouthWest(promoting) & enemy, -9, moves);
+            addPawnPromotions(shiftSouth(promoting) & empty & mask, -8, moves);
+        }
     }
-};
+}
 
-struct AddMovePawnPromote {
-    static inline void addMove(const Board& board, int from, int to, Board::MoveList& moves) {
-        const TPiece pieceFrom = board[from];
-        moves.push_back(Move(Move::Type::PAWN_PROMOTE, from, to, pieceFrom < 0 ? -PIECE_QUEEN : PIECE_QUEEN));
-        moves.push_back(Move(Move::Type::PAWN_PROMOTE, from, to, pieceFrom < 0 ? -PIECE_KNIGHT : PIECE_KNIGHT));
+/**
+ king steps to squares the enemy does not attack. the king is lifted off the
+ board first so it cannot hide behind itself from a slider it is fleeing.
+ */
+template<Board::GenType Type, Color Player>
+void Board::generateKingMoves(MoveList& moves, const CheckInfo& info) const {
+    constexpr TTeam player = Player;
+    if (info.kingSquare < 0)
+        return ;
+
+    const TBitboard enemy = getTeamPieces(-player);
+    const TBitboard occupied = getOccupied() ^ squareBit(info.kingSquare);
+    TBitboard targets = kingAttackTable[info.kingSquare] & ~getTeamPieces(player);
+    if (Type == GenType::CAPTURES)
+        targets &= enemy;
+    else if (Type == GenType::QUIETS)
+        targets &= ~enemy;
+
+    while (targets) {
+        const int to = popLsb(targets);
+        if ((attackersTo(to, occupied) & enemy) == 0)
+            moves.push_back(Move((enemy & squareBit(to)) ? Move::Type::LOUD : Move::Type::QUIET, info.kingSquare, to));
     }
-};
 
-template<class Check, class Add>
-inline bool addMove(const Board& board, int from, int to, Board::MoveList& moves) {
-    if (Check::can(board, from, to)) {
-        Add::addMove(board, from, to, moves);
-        return true;
+    if (Type != GenType::CAPTURES && !info.checkers)
+        generateCastles<Player>(moves);
+}
+
+/**
+ castling needs the right, the rook still home, an empty path between king
+ and rook, and no attacked square on the king's way. the generator only
+ calls this when the king is not in check.
+ */
+template<Color Player>
+void Board::generateCastles(MoveList& moves) const {
+    constexpr TTeam player = Player;
+    const int home = player > 0 ? 0 : 56; // a1 or a8
+    const TBoardFlags kingSide = player > 0 ? kFlagCastleWhiteKing : kFlagCastleBlackKing;
+    const TBoardFlags queenSide = player > 0 ? kFlagCastleWhiteQueen : kFlagCastleBlackQueen;
+    const TBitboard occupied = getOccupied();
+    const TBitboard rooks = getPieces(PIECE_ROOK, player);
+
+    if (!(getPieces(PIECE_KING, player) & squareBit(home + 4)))
+        return ;
+
+    if ((flags & kingSide) && (rooks & squareBit(home + 7)) && !(occupied & betweenTable[home + 4][home + 7]) &&
+        !isSquareAttacked(home + 5, -player) && !isSquareAttacked(home + 6, -player)) {
+        moves.push_back(Move(Move::Type::CASTLE, home + 4, home + 6));
+    }
+
+    if ((flags & queenSide) && (rooks & squareBit(home)) && !(occupied & betweenTable[home + 4][home]) &&
+        !isSquareAttacked(home + 3, -player) && !isSquareAttacked(home + 2, -player)) {
+        moves.push_back(Move(Move::Type::CASTLE, home + 4, home + 2));
     }
-    return false;
 }
 
-template<class Check, class Add, class CheckAfter, class AddAfter>
-inline void addSlide(const Board& board, const int from, const int offset, Board::MoveList& moves) {
-    int position = from + offset;
-    while (addMove<Check, Add>(board, from, position, moves)) {
-        position += offset;
+/**
+ en passant is checked by playing it out on the occupancy: two pawns leave
+ the capturing rank at once, which the pin mask cannot see, and capturing
+ the checking pawn is legal although the captured square is not a target.
+ */
+template<Color Player>
+void Board::generateEnPassant(MoveList& moves, const CheckInfo& info) const {
+    constexpr TTeam player = Player;
+    if (!(flags & kFlagEnPassant))
+        return ;
+
+    const int file = (flags & kFlagEnPassantFile) >> 4;
+    const int target = (player > 0 ? 5 : 2) * BOARD_DIM + file;
+    const int victim = target + (player > 0 ? -8 : 8);
+    const TBitboard enemy = getTeamPieces(-player);
+
+    TBitboard attackers = pawnAttackTable[teamIndex(-player)][target] & getPieces(PIECE_PAWN, player);
+    while (attackers) {
+        const int from = popLsb(attackers);
+        if (info.kingSquare >= 0) {
+            const TBitboard occupied = getOccupied() ^ squareBit(from) ^ squareBit(victim) ^ squareBit(target);
+            const TBitboard slidersLeft = (bishopAttacks(info.kingSquare, occupied) & (typeBitboards[PIECE_BISHOP] | typeBitboards[PIECE_QUEEN])) |
+                                          (rookAttacks(info.kingSquare, occupied) & (typeBitboards[PIECE_ROOK] | typeBitboards[PIECE_QUEEN]));
+            // any checker other than the captured pawn survives the capture
+            if ((slidersLeft & enemy) || (info.checkers & ~squareBit(victim) & ~(typeBitboards[PIECE_BISHOP] | typeBitboards[PIECE_ROOK] | typeBitboards[PIECE_QUEEN])))
+                continue ;
+        }
+        moves.push_back(Move(Move::Type::MOVE_EN_PASSENT, from, target));
     }
-    addMove<CheckAfter, AddAfter>(board, from, position, moves);
 }
 
-void Board::generateMoves(MoveList& moves, TTeam player, bool *attack_squares) const {
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        const int pos = mailbox64[i];
-        TPiece piece = pieces[pos];
-        if (piece == 0 || (piece < 0) != (player < 0))
-            continue ;
+/**
+ legal generation. CAPTURES emits captures and every promotion, QUIETS emits
+ everything else, ALL is the union of the two. non king moves are limited to
+ the check mask (anything when not in check, capturing or blocking the
+ checker in single check, nothing in double check) and pinned pieces to the
+ line between their king and the pinner.
+ */
+template<Board::GenType Type, Color Player>
+void Board::generate(MoveList& moves, const CheckInfo& info) const {
+    constexpr TTeam player = Player;
+    constexpr bool loud = Type != GenType::QUIETS;
+    constexpr bool quiet = Type != GenType::CAPTURES;
+
+    const TBitboard own = getTeamPieces(player);
+    const TBitboard enemy = getTeamPieces(-player);
+    const TBitboard occupied = own | enemy;
+
+    /* check evasions, only the king may move out of a double check */
+    TBitboard checkMask = ~TBitboard(0);
+    if (info.checkers) {
+        generateKingMoves<Type, Player>(moves, info);
+        if (info.checkers & (info.checkers - 1))
+            return ;
+        const int checker = bitScanForward(info.checkers);
+        checkMask = betweenTable[info.kingSquare][checker] | info.checkers;
+    }
+
+    const TBitboard targets = ((loud ? enemy : 0) | (quiet ? ~occupied : 0)) & checkMask;
+
+    if (loud)
+        generateEnPassant<Player>(moves, info);
+
+    /* pawns, pinned pawns are moved one at a time along their pin line */
+    const TBitboard pawns = getPieces(PIECE_PAWN, player);
+    generatePawnMoves<Type, Player>(moves, pawns & ~info.pinned, checkMask);
+    TBitboard pinnedPawns = pawns & info.pinned;
+    while (pinnedPawns) {
+        const int from = popLsb(pinnedPawns);
+        generatePawnMoves<Type, Player>(moves, squareBit(from), checkMask & lineTable[info.kingSquare][from]);
+    }
+
+    /* pieces, a pinned knight can never move */
+    TBitboard knights = getPieces(PIECE_KNIGHT, player) & ~info.pinned;
+    while (knights) {
+        const int from = popLsb(knights);
+        addMoves(from, knightAttackTable[from] & targets, enemy, moves);
+    }
+
+    TBitboard bishops = (getPieces(PIECE_BISHOP, player) | getPieces(PIECE_QUEEN, player));
+    while (bishops) {
+        const int from = popLsb(bishops);
+        const TBitboard pinMask = (info.pinned & squareBit(from)) ? lineTable[info.kingSquare][from] : ~TBitboard(0);
+        addMoves(from, bishopAttacks(from, occupied) & targets & pinMask, enemy, moves);
+    }
+
+    TBitboard rooks = (getPieces(PIECE_ROOK, player) | getPieces(PIECE_QUEEN, player));
+    while (rooks) {
+        const int from = popLsb(rooks);
+        const TBitboard pinMask = (info.pinned & squareBit(from)) ? lineTable[info.kingSquare][from] : ~TBitboard(0);
+        addMoves(from, rookAttacks(from, occupied) & targets & pinMask, enemy, moves);
+    }
+
+    if (!info.checkers)
+        generateKingMoves<Type, Player>(moves, info);
+}
+
+template<Color Player>
+void Board::generateMoves(MoveList& moves) const {
+    generate<GenType::ALL, Player>(moves, getCheckInfo(Player));
+}
+
+template<Color Player>
+void Board::generateCaptures(MoveList& moves, const CheckInfo& info) const {
+    generate<GenType::CAPTURES, Player>(moves, info);
+}
+
+template<Color Player>
+void Board::generateQuiets(MoveList& moves, const CheckInfo& info) const {
+    generate<GenType::QUIETS, Player>(moves, info);
+}
+
+template void Board::generateMoves<WHITE>(MoveList& moves) const;
+template void Board::generateMoves<BLACK>(MoveList& moves) const;
+template void Board::generateCaptures<WHITE>(MoveList& moves, const CheckInfo& info) const;
+template void Board::generateCaptures<BLACK>(MoveList& moves, const CheckInfo& info) const;
+template void Board::generateQuiets<WHITE>(MoveList& moves, const CheckInfo& info) const;
+template void Board::generateQuiets<BLACK>(MoveList& moves, const CheckInfo& info) const;
+
+void Board::generateMoves(MoveList& moves, TTeam player) const {
+    if (player > 0)
+        generateMoves<WHITE>(moves);
+    else
+        generateMoves<BLACK>(moves);
+}
+
+void Board::generateCaptures(MoveList& moves, TTeam player, const CheckInfo& info) const {
+    if (player > 0)
+        generateCaptures<WHITE>(moves, info);
+    else
+        generateCaptures<BLACK>(moves, info);
+}
+
+void Board::generateQuiets(MoveList& moves, TTeam player, const CheckInfo& info) const {
+    if (player > 0)
+        generateQuiets<WHITE>(moves, info);
+    else
+        generateQuiets<BLACK>(moves, info);
+}
+
+bool Board::isLegal(const Move& move, TTeam player, const CheckInfo& info) const {
+    const Move::Type type = move.type();
+    if (type == Move::Type::INVALID)
+        return false;
+
+    const int from = move.from();
+    const int to = move.to();
+    const TPiece piece = pieceAt(from);
+    const TPiece target = pieceAt(to);
+    if (piece == 0 || (piece < 0) != (player < 0))
+        return false;
+    if (target != 0 && (target < 0) == (player < 0))
+        return false;
+
+    // the rare special moves are vetted by generating them
+    if (type == Move::Type::CASTLE || type == Move::Type::MOVE_EN_PASSENT) {
+        MoveList special;
+        if (type == Move::Type::CASTLE && !info.checkers)
+            player > 0 ? generateCastles<WHITE>(special) : generateCastles<BLACK>(special);
+        else if (type == Move::Type::MOVE_EN_PASSENT && !(info.checkers & (info.checkers - 1)))
+            player > 0 ? generateEnPassant<WHITE>(special, info) : generateEnPassant<BLACK>(special, info);
+        for (const Move& m : special) {
+            if (m == move)
+                return true;
+        }
+        return false;
+    }
+
+    const TBitboard toBit = squareBit(to);
+    const TBitboard occupied = getOccupied();
+
+    /* is the move one the piece can make at all */
+    bool reachable;
+    if (abs(piece) == PIECE_PAWN) {
+        const int forward = player > 0 ? 8 : -8;
+        const TBitboard lastRank = player > 0 ? kRank8 : kRank1;
+        const TBitboard startRank = player > 0 ? kRank2 : kRank7;
+        if ((type == Move::Type::PAWN_PROMOTE) != ((toBit & lastRank) != 0))
+            return false;
+        if (target != 0)
+            reachable = (type == Move::Type::LOUD || type == Move::Type::PAWN_PROMOTE) && (pawnAttackTable[teamIndex(player)][from] & toBit);
+        else if (type == Move::Type::PAWN_DOUBLE)
+            reachable = to == from + 2 * forward && (squareBit(from) & startRank) && !(occupied & squareBit(from + forward));
+        else
+            reachable = (type == Move::Type::QUIET || type == Move::Type::PAWN_PROMOTE) && to == from + forward;
+    } else {
+        // pieces only emit QUIET for empty targets and LOUD for captures
+        if (type != (target != 0 ? Move::Type::LOUD : Move::Type::QUIET))
+            return false;
 
         switch (abs(piece)) {
-            case PIECE_PAWN:
-                if (piece > 0) {
-					if (i / BOARD_DIM == 6) {
-						// pawn promotion
-						addMove<CheckMoveLoud, AddMovePawnPromote>(*this, pos, pos + MAILBOX_W + 1, moves);
-						addMove<CheckMoveLoud, AddMovePawnPromote>(*this, pos, pos + MAILBOX_W - 1, moves);
-						addMove<CheckMoveQuiet, AddMovePawnPromote>(*this, pos, pos + MAILBOX_W, moves);
-					} else {
-						addMove<CheckMoveLoud, AddMoveLoud>(*this, pos, pos + MAILBOX_W + 1, moves);
-	                    addMove<CheckMoveLoud, AddMoveLoud>(*this, pos, pos + MAILBOX_W - 1, moves);
-						if (addMove<CheckMoveQuiet, AddMoveQuiet>(*this, pos, pos + MAILBOX_W, moves) && i / BOARD_DIM == 1) {
-	                        addMove<CheckMoveQuiet, AddMoveQuiet>(*this, pos, pos + MAILBOX_W * 2, moves);
-	                    }
-					}
-                } else {
-					if (i / BOARD_DIM == 1) {
-						// pawn promotion
-						addMove<CheckMoveLoud, AddMovePawnPromote>(*this, pos, pos - MAILBOX_W + 1, moves);
-						addMove<CheckMoveLoud, AddMovePawnPromote>(*this, pos, pos - MAILBOX_W - 1, moves);
-						addMove<CheckMoveQuiet, AddMovePawnPromote>(*this, pos, pos - MAILBOX_W, moves);
-					} else {
-						addMove<CheckMoveLoud, AddMoveLoud>(*this, pos, pos - MAILBOX_W + 1, moves);
-	                    addMove<CheckMoveLoud, AddMoveLoud>(*this, pos, pos - MAILBOX_W - 1, moves);
-						if (addMove<CheckMoveQuiet, AddMoveQuiet>(*this, pos, pos - MAILBOX_W, moves) && i / BOARD_DIM == 6) {
-	                        addMove<CheckMoveQuiet, AddMoveQuiet>(*this, pos, pos - MAILBOX_W * 2, moves);
-	                    }
-					}
-                }
-
-				// TODO: add pawn promotion
-
-                break ;
-            case PIECE_KNIGHT:
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos + MAILBOX_W + 2, moves);
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos + MAILBOX_W - 2, moves);
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos - MAILBOX_W + 2, moves);
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos - MAILBOX_W - 2, moves);
-
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos + MAILBOX_W * 2 + 1, moves);
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos + MAILBOX_W * 2 - 1, moves);
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos - MAILBOX_W * 2 + 1, moves);
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos - MAILBOX_W * 2 - 1, moves);
-                break ;
-            case PIECE_BISHOP:
-
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos,  MAILBOX_W + 1, moves);
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos,  MAILBOX_W - 1, moves);
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos, -MAILBOX_W + 1, moves);
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos, -MAILBOX_W - 1, moves);
-
-                break ;
-            case PIECE_ROOK:
-
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos,  1, moves);
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos, -1, moves);
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos,  MAILBOX_W, moves);
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos, -MAILBOX_W, moves);
-
-                break ;
-            case PIECE_QUEEN:
-
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos,  MAILBOX_W + 1, moves);
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos,  MAILBOX_W - 1, moves);
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos, -MAILBOX_W + 1, moves);
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos, -MAILBOX_W - 1, moves);
-
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos,  1, moves);
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos, -1, moves);
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos,  MAILBOX_W, moves);
-                addSlide<CheckMoveQuiet, AddMoveQuiet, CheckMoveLoud, AddMoveLoud>(*this, pos, -MAILBOX_W, moves);
-
-                break ;
-            case PIECE_KING:
-
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos + 1, moves);
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos - 1, moves);
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos + MAILBOX_W, moves);
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos - MAILBOX_W, moves);
-
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos + MAILBOX_W + 1, moves);
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos + MAILBOX_W - 1, moves);
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos - MAILBOX_W + 1, moves);
-                addMove<CheckMoveGeneric, AddMoveLoud>(*this, pos, pos - MAILBOX_W - 1, moves);
-
-				// TODO: add castling
-
-                break ;
-            default:
-                assert(0);
+            case PIECE_KNIGHT: reachable = (knightAttackTable[from] & toBit) != 0; break ;
+            case PIECE_BISHOP: reachable = (bishopAttacks(from, occupied) & toBit) != 0; break ;
+            case PIECE_ROOK: reachable = (rookAttacks(from, occupied) & toBit) != 0; break ;
+            case PIECE_QUEEN: reachable = (queenAttacks(from, occupied) & toBit) != 0; break ;
+            case PIECE_KING: reachable = (kingAttackTable[from] & toBit) != 0; break ;
+            default: reachable = false;
         }
     }
+    if (!reachable)
+        return false;
+
+    /* does it leave the king safe */
+    if (info.kingSquare < 0)
+        return true;
+    if (from == info.kingSquare)
+        return (attackersTo(to, occupied ^ squareBit(from)) & getTeamPieces(-player)) == 0;
+    if (info.checkers) {
+        if (info.checkers & (info.checkers - 1))
+            return false;
+        if (!((betweenTable[info.kingSquare][bitScanForward(info.checkers)] | info.checkers) & toBit))
+            return false;
+    }
+    return !(info.pinned & squareBit(from)) || (lineTable[info.kingSquare][from] & toBit);
+}
+
+/**
+ counts a piece on or off the material key. expects the bitboards to include
+ the piece, so call it after adding and before removing.
+ */
+inline void Board::updateMaterial(TPiece piece, int delta) {
+    const int type = abs(piece);
+    if (type == PIECE_KING)
+        return ;
+    if (popCount(getPieces(type, piece)) > kMaterialCap[type])
+        materialOverflow += delta;
+    else
+        materialKey += delta * kMaterialWeight[type] * (piece < 0 ? kMaterialSide : 1);
 }
 
 void Board::setPiece(int position, TPiece value) {
 #ifdef DEBUG_BOARD
     assert(mailbox[position] != -1);
-    assert(pieces[position] != 100);
 #endif
-    if (pieces[position] != 0) {
-        score -= getPieceScore(position);
-        hash ^= pieceHashTable[position * 16 + pieces[position] + 8];
+    const int square = mailbox[position];
+    const TBitboard bb = squareBit(square);
+
+    if (pieces[square] != 0) {
+        scoreMiddleGame -= pieceScoreTable[pieces[square] + 8][square];
+        scoreEndGame -= pieceScoreTableEndGame[pieces[square] + 8][square];
+        phase -= kPiecePhase[abs(pieces[square])];
+        updateMaterial(pieces[square], -1);
+        hash ^= pieceHashTable[square * 16 + pieces[square] + 8];
+        if (abs(pieces[square]) == PIECE_PAWN)
+            pawnHash ^= pieceHashTable[square * 16 + pieces[square] + 8];
+        typeBitboards[abs(pieces[square])] &= ~bb;
+        teamBitboards[teamIndex(pieces[square])] &= ~bb;
+        if (accumulator != nullptr)
+            accumulator->removePiece(pieces[square], square);
     }
 
-    pieces[position] = value;
-
-    if (pieces[position] != 0) {
-        score += getPieceScore(position);
-        hash ^= pieceHashTable[position * 16 + pieces[position] + 8];
+    pieces[square] = value;
+
+    if (pieces[square] != 0) {
+        scoreMiddleGame += pieceScoreTable[pieces[square] + 8][square];
+        scoreEndGame += pieceScoreTableEndGame[pieces[square] + 8][square];
+        phase += kPiecePhase[abs(pieces[square])];
+        hash ^= pieceHashTable[square * 16 + pieces[square] + 8];
+        if (abs(pieces[square]) == PIECE_PAWN)
+            pawnHash ^= pieceHashTable[square * 16 + pieces[square] + 8];
+        typeBitboards[abs(pieces[square])] |= bb;
+        teamBitboards[teamIndex(pieces[square])] |= bb;
+        updateMaterial(pieces[square], 1);
+        if (accumulator != nullptr)
+            accumulator->addPiece(pieces[square], square);
     }
 
 #ifdef DEBUG_BOARD
     uint64_t checkHash = flagHashTable[flags];
     int32_t checkScore = 0;
+    int32_t checkScoreEndGame = 0;
     for (int i = 0; i < 64; ++i) {
-        int position = mailbox64[i];
-        if (pieces[position] != 0) {
-            checkScore += getPieceScore(position);
-            checkHash ^= pieceHashTable[position * 16 + pieces[position] + 8];
+        if (pieces[i] != 0) {
+            checkScore += pieceScoreTable[pieces[i] + 8][i];
+            checkScoreEndGame += pieceScoreTableEndGame[pieces[i] + 8][i];
+            checkHash ^= pieceHashTable[i * 16 + pieces[i] + 8];
         }
     }
     assert(checkHash == hash);
-    assert(checkScore == score);
-#endif
-}
-
-
-/*
- Heuristic Function
- */
-
-
-inline TScore Board::getPieceScore(int position) const {
-	// TODO: determine when the end game has been reached!
-    const TPiece piece = pieces[position];
-    const int position64 = piece < 0 ? mirror64[mailbox[position]] : mailbox[position];
-    int sign = piece < 0 ? -1 : 1;
-    switch (piece * sign) {
-        case PIECE_PAWN: return (1000 + pawnSquareTable[position64]) * sign;
-        case PIECE_KNIGHT: return (3200 + knightSquareTable[position64]) * sign;
-        case PIECE_BISHOP: return (3300 + bishopSquareTable[position64]) * sign;
-        case PIECE_ROOK: return (5000 + rookSquareTable[position64]) * sign;
-        case PIECE_QUEEN: return (9000 + queenSquareTable[position64]) * sign;
-        case PIECE_KING: return (100000 + kingSquareTable[position64]) * sign;
-        default:
-#ifdef DEBUG_BOARD
-            assert(0);
+    assert(checkScore == scoreMiddleGame && checkScoreEndGame == scoreEndGame);
+    assert((teamBitboards[0] & teamBitboards[1]) == 0);
 #endif
-            return 0;
-    }
 }
@@ -15,175 +15,609 @@
 
 #include <iostream>
 #include <cassert>
-#include <stack>
+#include <cstdlib>
 #include <stdint.h>
 #include <string>
-#include <vector>
+#include <new>
+#include <type_traits>
 
 #include "constants.hpp"
+#include "bitboard.hpp"
+#include "nnue.hpp"
+
+constexpr int mailbox[120] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 1
+    -1,  0,  1,  2,  3,  4,  5,  6,  7, -1, // 2
+    -1,  8,  9, 10, 11, 12, 13, 14, 15, -1, // 3
+    -1, 16, 17, 18, 19, 20, 21, 22, 23, -1, // 4
+    -1, 24, 25, 26, 27, 28, 29, 30, 31, -1, // 5
+    -1, 32, 33, 34, 35, 36, 37, 38, 39, -1, // 6
+    -1, 40, 41, 42, 43, 44, 45, 46, 47, -1, // 7
+    -1, 48, 49, 50, 51, 52, 53, 54, 55, -1, // 8
+    -1, 56, 57, 58, 59, 60, 61, 62, 63, -1, // 9
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 10
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1  // 11
+};
 
-extern const int mailbox[120];
-extern const int mailbox64[64];
-extern int mirror64[64];
+constexpr int mailbox64[64] = {
+    21, 22, 23, 24, 25, 26, 27, 28,
+    31, 32, 33, 34, 35, 36, 37, 38,
+    41, 42, 43, 44, 45, 46, 47, 48,
+    51, 52, 53, 54, 55, 56, 57, 58,
+    61, 62, 63, 64, 65, 66, 67, 68,
+    71, 72, 73, 74, 75, 76, 77, 78,
+    81, 82, 83, 84, 85, 86, 87, 88,
+    91, 92, 93, 94, 95, 96, 97, 98
+};
 
-extern uint64_t pieceHashTable[64 * 16];
-extern uint64_t flagHashTable[256];
+// zobrist keys, generated at compile time in board.cpp
+extern const LookupTable<uint64_t, 64 * 16> pieceHashTable;
+extern const LookupTable<uint64_t, 256> flagHashTable;
+extern const TBoardFlags castleRightsMask[64]; // rights kept when a piece moves from or to a square (64 square index)
 
 extern char pieceGetLetter(TPiece piece);
 
+// index used by the per color tables, white = 0, black = 1
+inline int teamIndex(TTeam team) {
+    return team < 0 ? 1 : 0;
+}
+
 struct Move;
+class FixedMoveList;
+
+/**
+ what a move needs to undo itself. the incrementally maintained parts of the
+ board (hashes, scores, phase, material, flags) are saved whole, so unmake restores them instead
+ of recomputing them piece by piece.
+ */
+struct StateInfo {
+    int64_t hash;
+    uint64_t pawnHash;
+    TScore scoreMiddleGame;
+    TScore scoreEndGame;
+    int phase;
+    int materialKey;
+    int materialOverflow;
+    TBoardFlags flags;
+    TPiece captured; // piece on the destination before the move, 0 if none
+};
+
+/**
+ fixed array of undo records, one per ply. make pushes a record and unmake
+ pops it, so walking the tree never allocates.
+ */
+class StateStack {
+public:
+    static constexpr int kMaxPly = 256;
+
+private:
+    StateInfo states[kMaxPly];
+    int count = 0;
+
+public:
+    inline StateInfo& push() {
+#ifdef DEBUG_MOVE
+        assert(count < kMaxPly);
+#endif
+        return states[count++];
+    }
 
+    inline const StateInfo& pop() {
+#ifdef DEBUG_MOVE
+        assert(count > 0);
+#endif
+        return states[--count];
+    }
+
+    inline int size() const { return count; }
+};
+
+/**
+ for copy-make, where the parent board is the undo record. make still writes
+ its state but into a single slot that is never read back.
+ */
+class NullStateStack {
+private:
+    StateInfo scratch;
+
+public:
+    inline StateInfo& push() { return scratch; }
+    inline int size() const { return 0; }
+};
+
+/**
+ the board is kept trivially copyable and small (under three cache lines) so a
+ copy is a plain memcpy, which is what the copy-make search relies on.
+ pieces are stored per 64 square index, the mailbox accessors translate.
+ */
 class Board {
 private:
+    TBitboard typeBitboards[PIECE_KING + 1] = {0}; // occupancy by abs(piece), index 0 unused
+    TBitboard teamBitboards[2] = {0}; // occupancy by teamIndex
+
     int64_t hash = 0;
-    TScore score = 0; // int32_t
+    uint64_t pawnHash = 0; // zobrist key over the pawns only, for the pawn structure cache
+    TScore scoreMiddleGame = 0; // int32_t
+    TScore scoreEndGame = 0;
+    int phase = 0; // sum of kPiecePhase over the pieces on the board
+    int materialKey = 0; // index into the material table, see kMaterialWeight
+    int materialOverflow = 0; // pieces beyond the material key's caps
+    TPiece pieces[BOARD_SIZE] = {0}; // int8_t[64]
     TBoardFlags flags = 0; // uint8_t
-    TPiece pieces[120]; // int8_t[120]
-    int8_t enPassentSquare; // the en passent square... silly.
+
+    // first layer of the network, kept in step with the pieces while attached. not owned, copies share it
+    Accumulator* accumulator = nullptr;
+
+    void updateMaterial(TPiece piece, int delta);
 
 	// TODO: add a state history. Prevent searching nodes that result in state repeats. Rippp.
+
+    enum class GenType { CAPTURES, QUIETS, ALL };
+
 public:
-    Board();
-    Board(const Board& board);
+    /**
+     what the side to move needs to know about its king to generate legal
+     moves, computed once per node. squares use the 64 square index.
+     */
+    struct CheckInfo {
+        int kingSquare = -1; // -1 when the side has no king
+        TBitboard checkers = 0; // enemy pieces giving check
+        TBitboard pinned = 0; // own pieces pinned to the king
+    };
 
+private:
+    // each color gets its own instantiation, so pawn directions and home ranks are constants
+    template<GenType Type, Color Player>
+    void generate(FixedMoveList& moves, const CheckInfo& info) const;
+    template<GenType Type, Color Player>
+    void generatePawnMoves(FixedMoveList& moves, TBitboard pawns, TBitboard mask) const;
+    template<GenType Type, Color Player>
+    void generateKingMoves(FixedMoveList& moves, const CheckInfo& info) const;
+    template<Color Player>
+    void generateCastles(FixedMoveList& moves) const;
+    template<Color Player>
+    void generateEnPassant(FixedMoveList& moves, const CheckInfo& info) const;
+public:
+    Board();
     void setupBoard();
-    void loadBoardFromFEN(const char* FEN);
+    // reads placement, castling rights and en passant, the side to move is written to toMove if given
+    void loadBoardFromFEN(const char* FEN, TTeam* toMove = nullptr);
 
     std::string toString() const;
 
     inline TScore getScore() const {
-        return score;
+        // tapered between the middle and end game scores, promotions can push the phase past the total
+        const int weight = phase < kPhaseTotal ? phase : kPhaseTotal;
+        return (scoreMiddleGame * weight + scoreEndGame * (kPhaseTotal - weight)) / kPhaseTotal;
     }
 
     inline int64_t getZobristHash() const {
         return hash;
     }
 
+    // material table index, only meaningful when hasMaterialKey()
+    inline int getMaterialKey() const {
+        return materialKey;
+    }
+
+    inline bool hasMaterialKey() const {
+        return materialOverflow == 0;
+    }
+
+    inline uint64_t getPawnHash() const {
+        return pawnHash;
+    }
+
     void setPiece(int position, int8_t value);
 
+    /**
+     refreshes acc from the pieces and keeps it up to date from then on, nullptr
+     detaches. the accumulator is not part of the copy, a copied board updates
+     the same one, so copy-make search has to leave it detached.
+     */
+    inline void attachAccumulator(Accumulator* acc) {
+        accumulator = acc;
+        if (accumulator != nullptr)
+            accumulator->refresh(pieces);
+    }
+
+    inline const Accumulator* getAccumulator() const {
+        return accumulator;
+    }
+
+    // kPhaseTotal with every piece still on the board, falling toward 0 as they come off
+    inline int getPhase() const {
+        return phase;
+    }
+
+    // places a piece without touching hash or score, used by unmake before restoreState
+    inline void putPiece(int position, TPiece value) {
+        const int square = mailbox[position];
+        const TBitboard bb = squareBit(square);
+        if (pieces[square] != 0) {
+            typeBitboards[abs(pieces[square])] &= ~bb;
+            teamBitboards[teamIndex(pieces[square])] &= ~bb;
+            if (accumulator != nullptr)
+                accumulator->removePiece(pieces[square], square);
+        }
+        pieces[square] = value;
+        if (value != 0) {
+            typeBitboards[abs(value)] |= bb;
+            teamBitboards[teamIndex(value)] |= bb;
+            if (accumulator != nullptr)
+                accumulator->addPiece(value, square);
+        }
+    }
+
+    inline void saveState(StateInfo& state) const {
+        state.hash = hash;
+        state.pawnHash = pawnHash;
+        state.scoreMiddleGame = scoreMiddleGame;
+        state.scoreEndGame = scoreEndGame;
+        state.phase = phase;
+        state.materialKey = materialKey;
+        state.materialOverflow = materialOverflow;
+        state.flags = flags;
+    }
+
+    inline void restoreState(const StateInfo& state) {
+        hash = state.hash;
+        pawnHash = state.pawnHash;
+        scoreMiddleGame = state.scoreMiddleGame;
+        scoreEndGame = state.scoreEndGame;
+        phase = state.phase;
+        materialKey = state.materialKey;
+        materialOverflow = state.materialOverflow;
+        flags = state.flags;
+    }
+
+    // en passant flags to set after a pawn double pushes to position, nothing if no enemy pawn can take it
+    TBoardFlags enPassantFlags(int position) const;
+
     inline int8_t operator[] (int index) const {
-        return pieces[index];
+        return mailbox[index] < 0 ? OUT_OF_BOUNDS : pieces[mailbox[index]];
     };
 
-    inline TScore getPieceScore(int position) const;
+    // piece on a 64 square index
+    inline TPiece pieceAt(int square) const {
+        return pieces[square];
+    }
+
+
+    inline TBitboard getPieces(TPiece type) const {
+        return typeBitboards[type];
+    }
+
+    inline TBitboard getPieces(TPiece type, TTeam team) const {
+        return typeBitboards[type] & teamBitboards[teamIndex(team)];
+    }
+
+    // the bitboards double as piece lists, popLsb walks only the pieces that exist
+    inline int pieceCount(TPiece type, TTeam team) const {
+        return popCount(getPieces(type, team));
+    }
+
+    inline TBitboard getTeamPieces(TTeam team) const {
+        return teamBitboards[teamIndex(team)];
+    }
+
+    inline TBitboard getOccupied() const {
+        return teamBitboards[0] | teamBitboards[1];
+    }
 
-    inline uint8_t getFlags() { return flags; };
+    inline uint8_t getFlags() const { return flags; };
     inline void setFlags(uint8_t flags) {
         hash ^= flagHashTable[this->flags];
         this->flags = flags;
         hash ^= flagHashTable[this->flags];
     }
 
-    typedef std::vector<Move> MoveList;
-    void generateMoves(MoveList& moves, TTeam player, bool* attack_squares = nullptr) const;
+    // pieces of either team attacking square (64 square index) given the occupied set
+    TBitboard attackersTo(int square, TBitboard occupied) const;
+    CheckInfo getCheckInfo(TTeam player) const;
+
+    // all legal moves for player
+    typedef FixedMoveList MoveList;
+    void generateMoves(MoveList& moves, TTeam player) const;
+
+    // the staged move picker generates captures (and promotions) and quiets separately
+    void generateCaptures(MoveList& moves, TTeam player, const CheckInfo& info) const;
+    void generateQuiets(MoveList& moves, TTeam player, const CheckInfo& info) const;
+
+    // color specialized versions of the above, the TTeam ones dispatch to these
+    template<Color Player>
+    void generateMoves(MoveList& moves) const;
+    template<Color Player>
+    void generateCaptures(MoveList& moves, const CheckInfo& info) const;
+    template<Color Player>
+    void generateQuiets(MoveList& moves, const CheckInfo& info) const;
+
+    // true if move is one generateMoves would produce for player, used to vet hash and killer moves
+    bool isLegal(const Move& move, TTeam player, const CheckInfo& info) const;
+
+    /*
+     attack queries for the scoring function, legality checks and exchange
+     evaluation. indices are mailbox positions like the rest of the board api.
+     */
+
+    // true if any piece of byPlayer attacks the square (64 square index). cheap leapers are tried first
+    inline bool isSquareAttacked(int square, TTeam byPlayer) const {
+        const TBitboard attackers = getTeamPieces(byPlayer);
+        const TBitboard occupied = getOccupied();
+        return (pawnAttackTable[teamIndex(-byPlayer)][square] & typeBitboards[PIECE_PAWN] & attackers) ||
+               (knightAttackTable[square] & typeBitboards[PIECE_KNIGHT] & attackers) ||
+               (kingAttackTable[square] & typeBitboards[PIECE_KING] & attackers) ||
+               (bishopAttacks(square, occupied) & (typeBitboards[PIECE_BISHOP] | typeBitboards[PIECE_QUEEN]) & attackers) ||
+               (rookAttacks(square, occupied) & (typeBitboards[PIECE_ROOK] | typeBitboards[PIECE_QUEEN]) & attackers);
+    }
+
+    inline bool isAttacked(int index, TTeam byPlayer) const {
+        return isSquareAttacked(mailbox[index], byPlayer);
+    }
+
+    // true if the piece on index is defended by another piece of byPlayer
+    inline bool isProtected(int index, TTeam byPlayer) const {
+        return isAttacked(index, byPlayer);
+    }
 
-	// TODO: implement these for a MUCHLY improved scoring function
-	// void isProtected(int index, TTeam byPlayer) const;
-	// void isAttacked(int index, TTeam byPlayer) const;
-	// void isPinned(int index, TTeam byPlayer) const;
+    // true if the piece on index is pinned to its own king by a slider of byPlayer
+    inline bool isPinned(int index, TTeam byPlayer) const {
+        const int square = mailbox[index];
+        const TPiece piece = pieces[square];
+        const TBitboard king = getPieces(PIECE_KING, -byPlayer);
+        if (piece == 0 || piece * byPlayer > 0 || king == 0)
+            return false;
+
+        const int kingSquare = bitScanForward(king);
+        const TBitboard occupied = getOccupied();
+        if (!lineTable[kingSquare][square] || (betweenTable[kingSquare][square] & occupied))
+            return false;
+
+        // the first piece past ours on the line from the king has to be a matching slider
+        const TBitboard beyond = lineTable[kingSquare][square] & getTeamPieces(byPlayer);
+        if (rookAttacks(kingSquare, 0) & squareBit(square))
+            return (rookAttacks(square, occupied) & beyond & (typeBitboards[PIECE_ROOK] | typeBitboards[PIECE_QUEEN])) != 0;
+        return (bishopAttacks(square, occupied) & beyond & (typeBitboards[PIECE_BISHOP] | typeBitboards[PIECE_QUEEN])) != 0;
+    }
 };
 
+static_assert(std::is_trivially_copyable<Board>::value, "copy-make needs the board to be a plain memcpy");
+static_assert(sizeof(Board) <= 3 * 64, "the board should fit in three cache lines");
+
 /**
- internal representation of a move
+ internal representation of a move, packed into 16 bits: the from square in
+ bits 0-5, the to square in bits 6-11 (both 64 square indices) and a 4 bit
+ flag. ordering scores live beside the move list, not in the move.
  */
 struct Move {
 
     enum class Type : uint8_t {
         QUIET, // a move to an empty square
         LOUD, // a move involving a capture
-        PAWN_PROMOTE, // used by pawn promotions
-        CHANGE_FLAG, // used to change a flag. Indicates a king moving for the first time etc.
+        PAWN_PROMOTE, // used by pawn promotions, see promotion()
+        PAWN_DOUBLE, // a pawn moving two squares, may open up en passant
+        CASTLE, // from and to are the king squares, the rook is moved alongside
         MOVE_EN_PASSENT,
         INVALID
     };
 
-    typedef std::stack<int32_t> TMoveScratchStack;
+    typedef StateStack TMoveScratchStack;
 
-    Type type;
-    uint8_t from;
-    uint8_t to;
-    int8_t r1;
+private:
+    // flag values, promotions take the top four so the piece is (flag & 3) + PIECE_KNIGHT
+    enum : uint16_t {
+        FLAG_QUIET = 0,
+        FLAG_LOUD = 1,
+        FLAG_PAWN_DOUBLE = 2,
+        FLAG_CASTLE = 3,
+        FLAG_EN_PASSENT = 4,
+        FLAG_PROMOTE = 12
+    };
 
-    // special storage for sort ordering etc.
-    TScore score = kScoreNotYetDetermined;
-    uint64_t zobristHash = 0;
+    uint16_t data;
+
+    static inline uint16_t flagFor(Type type, TPiece promotion) {
+        switch (type) {
+            case Type::LOUD: return FLAG_LOUD;
+            case Type::PAWN_DOUBLE: return FLAG_PAWN_DOUBLE;
+            case Type::CASTLE: return FLAG_CASTLE;
+            case Type::MOVE_EN_PASSENT: return FLAG_EN_PASSENT;
+            case Type::PAWN_PROMOTE: return FLAG_PROMOTE | (abs(promotion) - PIECE_KNIGHT);
+            default: return FLAG_QUIET;
+        }
+    }
 
-    Move() : type(Type::INVALID) {
+public:
+    // a1a1 is never a real move, so the all zero encoding doubles as INVALID
+    Move() : data(0) {
 
     };
 
-    Move(Type type, uint8_t from, uint8_t to) : type(type), from(from), to(to) {
+    // from and to are 64 square indices, promotion is the piece a pawn becomes (either sign)
+    Move(Type type, int from, int to, TPiece promotion = 0)
+        : data(uint16_t(from | (to << 6) | (flagFor(type, promotion) << 12))) {
 #ifdef DEBUG_MOVE
-        assert(mailbox[from] != -1);
-        assert(mailbox[to] != -1);
+        assert(from >= 0 && from < 64);
+        assert(to >= 0 && to < 64);
 #endif
     };
 
-    Move(Type type, uint8_t from, uint8_t to, int8_t data) : type(type), from(from), to(to), r1(data) { };
+    inline int from() const { return data & 0x3F; }
+    inline int to() const { return (data >> 6) & 0x3F; }
+    inline uint16_t raw() const { return data; }
+
+    inline Type type() const {
+        if (data == 0)
+            return Type::INVALID;
+        switch (data >> 12) {
+            case FLAG_QUIET: return Type::QUIET;
+            case FLAG_LOUD: return Type::LOUD;
+            case FLAG_PAWN_DOUBLE: return Type::PAWN_DOUBLE;
+            case FLAG_CASTLE: return Type::CASTLE;
+            case FLAG_EN_PASSENT: return Type::MOVE_EN_PASSENT;
+            default: return Type::PAWN_PROMOTE;
+        }
+    }
+
+    // unsigned piece a promotion turns into, only meaningful for PAWN_PROMOTE
+    inline TPiece promotion() const { return TPiece(((data >> 12) & 3) + PIECE_KNIGHT); }
+
+    inline bool operator== (const Move& other) const { return data == other.data; }
+    inline bool operator!= (const Move& other) const { return data != other.data; }
+
+    // squares of the rook for a castle, kingside when the king moves right
+    inline int castleRookFrom() const { return to() > from() ? to() + 1 : to() - 2; }
+    inline int castleRookTo() const { return to() > from() ? to() - 1 : to() + 1; }
+
+    // square of the pawn taken en passant, beside the mover's destination
+    inline int enPassantVictim() const { return to() > from() ? to() - BOARD_DIM : to() + BOARD_DIM; }
+
+    // the TTeam free versions read the side from the moving piece and dispatch to the color specialized ones
+    template<class Stack>
+    void make(Board& board, Stack& stack) const {
+        if (board.pieceAt(from()) < 0)
+            make<BLACK>(board, stack);
+        else
+            make<WHITE>(board, stack);
+    }
 
     template<class Stack>
+    void unmake(Board& board, Stack& stack) const {
+        if (board.pieceAt(to()) < 0)
+            unmake<BLACK>(board, stack);
+        else
+            unmake<WHITE>(board, stack);
+    }
+
+    template<Color Player, class Stack>
     void make(Board& board, Stack& stack) const {
+        const Type type = this->type();
+        if (type == Type::INVALID)
+            return ;
+
+        const int from = mailbox64[this->from()];
+        const int to = mailbox64[this->to()];
+
+        StateInfo& state = stack.push();
+        board.saveState(state);
+        state.captured = board[to];
+
+        // every move clears en passant and may cost castling rights
+        TBoardFlags flags = board.getFlags() & kFlagCastleAll & castleRightsMask[this->from()] & castleRightsMask[this->to()];
+
         switch (type) {
             case Type::QUIET:
-                board.setPiece(to, board[from]);
-                board.setPiece(from, 0);
-                break ;
             case Type::LOUD:
-                stack.push(board[from]);
-                stack.push(board[to]);
                 board.setPiece(to, board[from]);
                 board.setPiece(from, 0);
                 break ;
             case Type::PAWN_PROMOTE:
-                stack.push(board[from]);
-                stack.push(board[to]);
-                board.setPiece(to, r1);
+                board.setPiece(to, Player * promotion());
                 board.setPiece(from, 0);
 				break ;
-            case Type::CHANGE_FLAG:
-                stack.push(board[from]);
-                stack.push(board[to]);
-                stack.push(board.getFlags());
-
+            case Type::PAWN_DOUBLE:
                 board.setPiece(to, board[from]);
                 board.setPiece(from, 0);
-                board.setFlags((uint8_t)r1);
-				break ;
+                flags |= board.enPassantFlags(to);
+                break ;
+            case Type::CASTLE:
+                board.setPiece(to, board[from]);
+                board.setPiece(from, 0);
+                board.setPiece(mailbox64[castleRookTo()], Player * PIECE_ROOK);
+                board.setPiece(mailbox64[castleRookFrom()], 0);
+                break ;
+            case Type::MOVE_EN_PASSENT:
+                board.setPiece(to, board[from]);
+                board.setPiece(from, 0);
+                board.setPiece(mailbox64[enPassantVictim()], 0);
+                break ;
 #ifdef DEBUG_MOVE
             default:
                 assert(0);
 #endif
         }
+
+        board.setFlags(flags);
     }
 
-    template<class Stack>
+    template<Color Player, class Stack>
     void unmake(Board& board, Stack& stack) const {
+        const Type type = this->type();
+        if (type == Type::INVALID)
+            return ;
+
+        const int from = mailbox64[this->from()];
+        const int to = mailbox64[this->to()];
+        const StateInfo& state = stack.pop();
+
+        // pieces go back without rehashing, the saved state restores hash and score in one go
         switch (type) {
             case Type::QUIET:
-                board.setPiece(from, board[to]);
-                board.setPiece(to, 0);
-                break ;
             case Type::LOUD:
+            case Type::PAWN_DOUBLE:
+                board.putPiece(from, board[to]);
+                board.putPiece(to, state.captured);
+                break ;
             case Type::PAWN_PROMOTE:
-                board.setPiece(to, stack.top());
-                stack.pop();
-                board.setPiece(from, stack.top());
-                stack.pop();
+                board.putPiece(from, Player * PIECE_PAWN);
+                board.putPiece(to, state.captured);
                 break ;
-            case Type::CHANGE_FLAG:
-                board.setFlags((uint8_t)stack.top());
-                stack.pop();
-                board.setPiece(to, stack.top());
-                stack.pop();
-                board.setPiece(from, stack.top());
-                stack.pop();
+            case Type::CASTLE:
+                board.putPiece(mailbox64[castleRookFrom()], Player * PIECE_ROOK);
+                board.putPiece(mailbox64[castleRookTo()], 0);
+                board.putPiece(from, board[to]);
+                board.putPiece(to, 0);
+                break ;
+            case Type::MOVE_EN_PASSENT:
+                board.putPiece(mailbox64[enPassantVictim()], -Player * PIECE_PAWN);
+                board.putPiece(from, board[to]);
+                board.putPiece(to, 0);
                 break ;
 #ifdef DEBUG_MOVE
             default:
                 assert(0);
 #endif
         }
+
+        board.restoreState(state);
     }
 };
 
+static_assert(sizeof(Move) == 2, "moves should pack into 16 bits");
+
+/**
+ fixed capacity move buffer, lives on the stack so generating moves never
+ touches the allocator. 256 is comfortably above the 218 move maximum.
+ */
+class FixedMoveList {
+public:
+    static constexpr int kCapacity = 256;
+
+private:
+    // raw storage so constructing a list does not default construct every slot
+    typename std::aligned_storage<sizeof(Move), alignof(Move)>::type storage[kCapacity];
+    int count = 0;
+
+public:
+    inline void push_back(const Move& move) {
+#ifdef DEBUG_MOVE_GENERATION
+        assert(count < kCapacity);
+#endif
+        new (&storage[count++]) Move(move);
+    }
+
+    inline void clear() { count = 0; }
+    inline int size() const { return count; }
+    inline bool empty() const { return count == 0; }
+
+    inline Move* begin() { return reinterpret_cast<Move*>(storage); }
+    inline Move* end() { return begin() + count; }
+    inline const Move* begin() const { return reinterpret_cast<const Move*>(storage); }
+    inline const Move* end() const { return begin() + count; }
+
+    inline Move& operator[] (int index) { return begin()[index]; }
+    inline const Move& operator[] (int index) const { return begin()[index]; }
+};
+
 #endif /* board_hpp */
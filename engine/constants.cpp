@@ -1,7 +1,9 @@
+#include "constants.hpp"
+
 // taken from https://chessprogramming.wikispaces.com/Simplified+evaluation+function
 // TODO: have these read in from a file
 
-double pawnSquareTable[] = {
+constexpr int pawnSquareTable[BOARD_SIZE] = {
     // pawn square table
     0,  0,  0,  0,  0,  0,  0,  0,
     5, 10, 10,-20,-20, 10, 10,  5,
@@ -13,7 +15,7 @@ double pawnSquareTable[] = {
     0,  0,  0,  0,  0,  0,  0,  0,
 };
 
-double knightSquareTable[] = {
+constexpr int knightSquareTable[BOARD_SIZE] = {
     // knight
     -50,-40,-30,-30,-30,-30,-40,-50,
     -40,-20,  0,  0,  0,  0,-20,-40,
@@ -25,7 +27,7 @@ double knightSquareTable[] = {
     -50,-40,-30,-30,-30,-30,-40,-50,
 };
 
-double bishopSquareTable[] = {
+constexpr int bishopSquareTable[BOARD_SIZE] = {
     // bishop
     -20,-10,-10,-10,-10,-10,-10,-20,
     -10,  0,  0,  0,  0,  0,  0,-10,
@@ -37,7 +39,7 @@ double bishopSquareTable[] = {
     -20,-10,-10,-10,-10,-10,-10,-20,
 };
 
-double rookSquareTable[] = {
+constexpr int rookSquareTable[BOARD_SIZE] = {
     // rook
     0,  0,  0,  0,  0,  0,  0,  0,
     5, 10, 10, 10, 10, 10, 10,  5,
@@ -49,7 +51,7 @@ double rookSquareTable[] = {
     0,  0,  0,  5,  5,  0,  0,  0,
 };
 
-double queenSquareTable[] = {
+constexpr int queenSquareTable[BOARD_SIZE] = {
     //queen
     -20,-10,-10, -5, -5,-10,-10,-20,
     -10,  0,  0,  0,  0,  0,  0,-10,
@@ -61,7 +63,7 @@ double queenSquareTable[] = {
     -20,-10,-10, -5, -5,-10,-10,-20,
 };
 
-double kingSquareTable[] = {
+constexpr int kingSquareTable[BOARD_SIZE] = {
     // king middle game
     20, 30, 10,  0,  0, 10, 30, 20,
     20, 20,  0,  0,  0,  0, 20, 20,
@@ -73,14 +75,40 @@ double kingSquareTable[] = {
     -30,-40,-40,-50,-50,-40,-40,-30,
 };
 
-double kingSquareTableEndGame[] = {
+constexpr int kingSquareTableEndGame[BOARD_SIZE] = {
     // king end game
-    -50,-40,-30,-20,-20,-30,-40,-50,
-    -30,-20,-10,  0,  0,-10,-20,-30,
+    -50,-30,-30,-30,-30,-30,-30,-50,
+    -30,-30,  0,  0,  0,  0,-30,-30,
     -30,-10, 20, 30, 30, 20,-10,-30,
     -30,-10, 30, 40, 40, 30,-10,-30,
     -30,-10, 30, 40, 40, 30,-10,-30,
     -30,-10, 20, 30, 30, 20,-10,-30,
-    -30,-30,  0,  0,  0,  0,-30,-30,
-    -50,-30,-30,-30,-30,-30,-30,-50,
+    -30,-20,-10,  0,  0,-10,-20,-30,
+    -50,-40,-30,-20,-20,-30,-40,-50,
+};
+
+// material values, indexed by abs(piece)
+static constexpr TScore pieceValues[PIECE_KING + 1] = {0, 1000, 3200, 3300, 5000, 9000, 100000};
+
+static constexpr const int* pieceSquareTables[PIECE_KING + 1] = {
+    nullptr, pawnSquareTable, knightSquareTable, bishopSquareTable, rookSquareTable, queenSquareTable, kingSquareTable
 };
+
+static constexpr const int* pieceSquareTablesEndGame[PIECE_KING + 1] = {
+    nullptr, pawnSquareTable, knightSquareTable, bishopSquareTable, rookSquareTable, queenSquareTable, kingSquareTableEndGame
+};
+
+// the tables are written from white's side, black reads them flipped vertically (square ^ 56)
+static constexpr LookupTable<LookupTable<TScore, BOARD_SIZE>, 16> generatePieceScores(const int* const* squareTables) {
+    LookupTable<LookupTable<TScore, BOARD_SIZE>, 16> table = {};
+    for (int type = PIECE_PAWN; type <= PIECE_KING; ++type) {
+        for (int square = 0; square < BOARD_SIZE; ++square) {
+            table[8 + type][square] = pieceValues[type] + squareTables[type][square];
+            table[8 - type][square] = -(pieceValues[type] + squareTables[type][square ^ 56]);
+        }
+    }
+    return table;
+}
+
+constexpr LookupTable<LookupTable<TScore, BOARD_SIZE>, 16> pieceScoreTable = generatePieceScores(pieceSquareTables);
+constexpr LookupTable<LookupTable<TScore, BOARD_SIZE>, 16> pieceScoreTableEndGame = generatePieceScores(pieceSquareTablesEndGame);
@@ -10,6 +10,7 @@
 #define constants_h
 
 #include <stdint.h>
+#include <limits>
 
 constexpr int BOARD_SIZE = 64;
 constexpr int BOARD_DIM = 8;
@@ -32,20 +33,71 @@ typedef int8_t TPiece;
 typedef uint8_t TBoardFlags;
 typedef int TTeam;
 
+// side as a compile time constant for the color specialized templates, the values match TTeam
+enum Color : int {
+    WHITE = 1,
+    BLACK = -1
+};
+
+constexpr Color opposite(Color color) {
+    return color == WHITE ? BLACK : WHITE;
+}
+
+// TBoardFlags layout: bits 0-3 castling rights, bits 4-6 en passant file, bit 7 en passant available
+constexpr TBoardFlags kFlagCastleWhiteKing = 1 << 0;
+constexpr TBoardFlags kFlagCastleWhiteQueen = 1 << 1;
+constexpr TBoardFlags kFlagCastleBlackKing = 1 << 2;
+constexpr TBoardFlags kFlagCastleBlackQueen = 1 << 3;
+constexpr TBoardFlags kFlagCastleAll = 0x0F;
+constexpr TBoardFlags kFlagEnPassantFile = 0x70;
+constexpr TBoardFlags kFlagEnPassant = 1 << 7;
+
+/**
+ fixed size table that a constexpr function can fill in, so generated tables
+ land in read only data instead of being built by static constructors.
+ */
+template<class T, int N>
+struct LookupTable {
+    T data[N];
+
+    constexpr const T& operator[] (int index) const { return data[index]; }
+    constexpr T& operator[] (int index) { return data[index]; }
+};
+
 constexpr TScore kScoreNotYetDetermined = std::numeric_limits<TScore>::max();
+constexpr TScore kScoreMate = 10000000; // well clear of any material total
+
+extern const int pawnSquareTable[BOARD_SIZE];
+
+extern const int knightSquareTable[BOARD_SIZE];
+
+extern const int bishopSquareTable[BOARD_SIZE];
 
-extern double pawnSquareTable[BOARD_SIZE];
+extern const int rookSquareTable[BOARD_SIZE];
 
-extern double knightSquareTable[BOARD_SIZE];
+extern const int queenSquareTable[BOARD_SIZE];
+extern const int kingSquareTable[BOARD_SIZE];
 
-extern double bishopSquareTable[BOARD_SIZE];
+extern const int kingSquareTableEndGame[BOARD_SIZE];
 
-extern double rookSquareTable[BOARD_SIZE];
+// material plus piece square bonus from white's point of view, [piece + 8][square], mirroring already applied
+extern const LookupTable<LookupTable<TScore, BOARD_SIZE>, 16> pieceScoreTable;
+// the same for the end game, only the king's table differs
+extern const LookupTable<LookupTable<TScore, BOARD_SIZE>, 16> pieceScoreTableEndGame;
 
-extern double queenSquareTable[BOARD_SIZE];
-extern double kingSquareTable[BOARD_SIZE];
+// game phase weight of each piece type, a full set of pieces adds up to kPhaseTotal
+constexpr int kPiecePhase[PIECE_KING + 1] = {0, 0, 1, 1, 2, 4, 0};
+constexpr int kPhaseTotal = 24;
 
-extern double kingSquareTableEndGame[BOARD_SIZE];
+/*
+ material key: a mixed radix number with one digit per piece type and side,
+ white's digits first. pieces past a digit's cap (a third knight, a second
+ queen) are counted as overflow instead, and such boards skip the material table.
+ */
+constexpr int kMaterialCap[PIECE_KING + 1] = {0, 8, 2, 2, 2, 1, 0};
+constexpr int kMaterialWeight[PIECE_KING + 1] = {0, 1, 9, 27, 81, 243, 0};
+constexpr int kMaterialSide = 486; // combinations for one side, 9 * 3 * 3 * 3 * 2
+constexpr int kMaterialTableSize = kMaterialSide * kMaterialSide;
 
 
 #endif /* constants_h */
@@ -0,0 +1,235 @@
+//
+//  evaluation.hpp
+//  engine
+//
+//  Created by Gareth George on 1/12/17.
+//  Copyright © 2017 Gareth George. All rights reserved.
+//
+
+#ifndef evaluation_hpp
+#define evaluation_hpp
+
+#include <cstddef>
+#include <limits>
+
+#include "constants.hpp"
+#include "board.hpp"
+#include "pawns.hpp"
+#include "material.hpp"
+#include "mobility.hpp"
+#include "nnue.hpp"
+
+/**
+ the static evaluation is put together at compile time from term policies.
+ a term is a type with
+
+   static constexpr bool kCheap;    kept incrementally by the board, scored before the lazy cut
+   static constexpr TScore kMargin; most an expensive term can move the score, sets the lazy margin
+   TScore operator() (const Board& board, const MaterialEntry& material);
+
+ and is scaled by an integer Weight. a configuration compiles down to exactly
+ the terms it lists, a term with a zero weight compiles to nothing. an
+ expensive term is clamped to its margin, so a pile of passers or a swarm of
+ active pieces saturates rather than breaking the lazy bound.
+ */
+
+// Num / Den in integer arithmetic, the tuning knob of a term
+template<int Num, int Den = 1>
+struct Weight {
+    static_assert(Den > 0, "weights need a positive denominator");
+    static constexpr bool kEnabled = Num != 0;
+
+    static constexpr TScore apply(TScore value) {
+        return Den == 1 ? value * Num : value * Num / Den;
+    }
+};
+
+// piece values and piece squares, tapered by the board
+template<typename W>
+struct MaterialTerm {
+    static constexpr bool kCheap = true;
+    static constexpr TScore kMargin = 0;
+
+    inline TScore operator() (const Board& board, const MaterialEntry&) {
+        return W::apply(board.getScore());
+    }
+};
+
+// bishop pair and other piece count terms, from the material table
+template<typename W>
+struct ImbalanceTerm {
+    static constexpr bool kCheap = true;
+    static constexpr TScore kMargin = 0;
+
+    inline TScore operator() (const Board&, const MaterialEntry& material) {
+        return W::apply(material.imbalance);
+    }
+};
+
+// pawn structure only changes on pawn moves and captures, so it comes out of the pawn cache
+template<typename W, bool Enabled = W::kEnabled>
+struct PawnStructureTerm {
+    static constexpr bool kCheap = false;
+    static constexpr TScore kMargin = W::apply(1000);
+
+    PawnTable pawnTable{1 << 14};
+
+    inline TScore operator() (const Board& board, const MaterialEntry&) {
+        return W::apply(pawnTable.probe(board));
+    }
+};
+
+// switched off, there is no pawn table to allocate
+template<typename W>
+struct PawnStructureTerm<W, false> {
+    static constexpr bool kCheap = false;
+    static constexpr TScore kMargin = 0;
+
+    inline TScore operator() (const Board&, const MaterialEntry&) {
+        return 0;
+    }
+};
+
+// mobility and king safety share one pass over the attack sets, a zero weight drops its half of it
+template<typename MobilityW, typename KingSafetyW>
+struct ActivityTerm {
+    static constexpr bool kCheap = false;
+    static constexpr TScore kMargin = (MobilityW::kEnabled ? MobilityW::apply(150) : 0) +
+                                      (KingSafetyW::kEnabled ? KingSafetyW::apply(500) : 0);
+
+    inline TScore operator() (const Board& board, const MaterialEntry&) {
+        if (!MobilityW::kEnabled && !KingSafetyW::kEnabled)
+            return 0;
+        const Mobility mobility = evaluateMobility<MobilityW::kEnabled, KingSafetyW::kEnabled>(board);
+        return MobilityW::apply(mobility.mobility) + KingSafetyW::apply(mobility.kingSafety);
+    }
+};
+
+// drives a bare king to the edge once the material table says the other side can mate
+template<typename W>
+struct MopUpTerm {
+    static constexpr bool kCheap = false;
+    static constexpr TScore kMargin = W::kEnabled ? W::apply(600) : 0;
+
+    inline TScore operator() (const Board& board, const MaterialEntry& material) {
+        return W::kEnabled ? W::apply(mopUpScore(board, material.flags)) : 0;
+    }
+};
+
+/**
+ the terms of a configuration, sum<true> adds up the cheap ones and
+ sum<false> the expensive ones. the other kind is a constant false branch.
+ */
+template<typename... Terms>
+struct TermList {
+    static constexpr TScore kMargin = 0;
+
+    template<bool Cheap>
+    inline TScore sum(const Board&, const MaterialEntry&) {
+        return 0;
+    }
+};
+
+template<typename Term, typename... Rest>
+struct TermList<Term, Rest...> {
+    static constexpr TScore kMargin = (Term::kCheap ? 0 : Term::kMargin) + TermList<Rest...>::kMargin;
+
+    Term term;
+    TermList<Rest...> rest;
+
+    template<bool Cheap>
+    inline TScore sum(const Board& board, const MaterialEntry& material) {
+        return (Term::kCheap == Cheap ? score(board, material) : 0) + rest.template sum<Cheap>(board, material);
+    }
+
+private:
+    inline TScore score(const Board& board, const MaterialEntry& material) {
+        const TScore value = term(board, material);
+        if (Term::kCheap)
+            return value;
+        return value > Term::kMargin ? Term::kMargin : (value < -Term::kMargin ? -Term::kMargin : value);
+    }
+};
+
+template<typename... Terms>
+class Evaluator {
+private:
+    TermList<Terms...> terms;
+
+public:
+    // how far the expensive terms together can move the score
+    static constexpr TScore kLazyMargin = TermList<Terms...>::kMargin;
+
+    size_t evaluations = 0;
+    size_t lazyExits = 0;
+
+    inline TScore operator() (const Board& board) {
+        bool exact;
+        return (*this)(board, -std::numeric_limits<TScore>::max(), std::numeric_limits<TScore>::max(), exact);
+    }
+
+    /**
+     lazy evaluation against a window from white's point of view. exact is
+     cleared when the expensive terms were skipped, the score is then only a
+     bound that is still outside the window and must not be cached.
+     */
+    TScore operator() (const Board& board, TScore alpha, TScore beta, bool& exact) {
+        evaluations++;
+        exact = true;
+
+        // a loaded network replaces the hand written terms
+        if (board.getAccumulator() != nullptr)
+            return board.getAccumulator()->evaluate();
+
+        // everything that only depends on the piece counts is one lookup on the material key
+        const MaterialEntry& material = probeMaterial(board);
+        if (material.flags & kMaterialDraw)
+            return 0;
+
+        // the incremental part alone already decides most leaves, the rest can't bring them back into the window
+        const TScore cheapScore = terms.template sum<true>(board, material);
+        if (kLazyMargin > 0 && (cheapScore + kLazyMargin <= alpha || cheapScore - kLazyMargin >= beta)) {
+            lazyExits++;
+            exact = false;
+            return cheapScore;
+        }
+
+        return cheapScore + terms.template sum<false>(board, material);
+    }
+};
+
+/*
+ the configuration the engine plays with. the weights were the double
+ multipliers on the old score function (materialMult, duplicatePieceMult,
+ opennessMult, kingSafetyMult). building with EVAL_NO_PAWNS,
+ EVAL_NO_MOBILITY, EVAL_NO_KING_SAFETY or EVAL_NO_MOP_UP takes a term out for
+ A/B testing, see the chess_engine_b target.
+ */
+#ifdef EVAL_NO_PAWNS
+typedef Weight<0> PawnStructureWeight;
+#else
+typedef Weight<1> PawnStructureWeight;
+#endif
+
+#ifdef EVAL_NO_MOBILITY
+typedef Weight<0> MobilityWeight;
+#else
+typedef Weight<7> MobilityWeight;
+#endif
+
+#ifdef EVAL_NO_KING_SAFETY
+typedef Weight<0> KingSafetyWeight;
+#else
+typedef Weight<1> KingSafetyWeight;
+#endif
+
+#ifdef EVAL_NO_MOP_UP
+typedef Weight<0> MopUpWeight;
+#else
+typedef Weight<1> MopUpWeight;
+#endif
+
+typedef Evaluator<MaterialTerm<Weight<1>>, ImbalanceTerm<Weight<1>>, PawnStructureTerm<PawnStructureWeight>,
+                  ActivityTerm<MobilityWeight, KingSafetyWeight>, MopUpTerm<MopUpWeight>> ScoreFunction;
+
+#endif /* evaluation_hpp */
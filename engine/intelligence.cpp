@@ -9,7 +9,6 @@
 #include <algorithm>
 #include <cassert>
 #include <stdint.h>
-#include <stack>
 #include <thread>
 
 #include "include/fastrand.h"
@@ -25,12 +24,13 @@ TransTable::~TransTable() {
     delete[] table;
 }
 
-inline void TransTable::insert(uint64_t hash, int depth, TScore score) {
+inline void TransTable::insert(uint64_t hash, int depth, TScore score, const Move& bestMove) {
     if (table[hash % size].isEmpty() || table[hash % size].depth < depth || fast_rand() % 3 == 0) {
         TTEntry entry;
         entry.hash = hash;
         entry.score = score;
         entry.depth = depth;
+        entry.move = bestMove;
         table[hash % size] = entry;
     }
 }
@@ -41,44 +41,154 @@ inline TTEntry* TransTable::lookup(uint64_t hash, int depth) const {
     return &entry;
 }
 
+inline TTEntry* TransTable::probe(uint64_t hash) const {
+    TTEntry& entry = table[hash % size];
+    if (entry.isEmpty() || entry.hash != hash) return nullptr;
+    return &entry;
+}
+
+EvalCache::EvalCache(size_t size) : size(size) {
+    this->table = new std::atomic<uint64_t>[size];
+    for (size_t i = 0; i < size; ++i)
+        table[i].store(0, std::memory_order_relaxed);
+}
+
+EvalCache::~EvalCache() {
+    delete[] table;
+}
+
+/** staged move picker */
+MovePicker::MovePicker(const Board& board, TTeam color, const Move& hashMove, const Move* killers)
+    : board(board), color(color), hashMove(hashMove), killers(killers), checkInfo(board.getCheckInfo(color)) {
+}
+
+// moves handed out by an earlier stage are skipped when the generated lists come up
+inline bool MovePicker::isSpecial(const Move& move) const {
+    if (move == hashMove)
+        return true;
+    if (killers != nullptr && stage == Stage::QUIETS) {
+        for (int i = 0; i < kKillers; ++i) {
+            if (move == killers[i])
+                return true;
+        }
+    }
+    return false;
+}
+
+bool MovePicker::next(Move& move) {
+    while (true) {
+        switch (stage) {
+            case Stage::HASH_MOVE:
+                stage = Stage::GENERATE_CAPTURES;
+                if (board.isLegal(hashMove, color, checkInfo)) {
+                    move = hashMove;
+                    return true;
+                }
+                break ;
+
+            case Stage::GENERATE_CAPTURES:
+                board.generateCaptures(moves, color, checkInfo);
+                // MVV-LVA, the most valuable victim first and the cheapest attacker to break ties
+                for (int i = 0; i < moves.size(); ++i) {
+                    const Move& m = moves[i];
+                    if (m.type() == Move::Type::PAWN_PROMOTE)
+                        scores[i] = m.promotion() * 16 + abs(board.pieceAt(m.to())) * 16;
+                    else
+                        scores[i] = abs(board.pieceAt(m.to())) * 16 - abs(board.pieceAt(m.from()));
+                }
+                current = 0;
+                stage = Stage::CAPTURES;
+                break ;
+
+            case Stage::CAPTURES:
+                while (current < moves.size()) {
+                    // selection sort one step at a time, a cut off leaves the rest unsorted
+                    int best = current;
+                    for (int i = current + 1; i < moves.size(); ++i) {
+                        if (scores[i] > scores[best])
+                            best = i;
+                    }
+                    std::swap(moves[current], moves[best]);
+                    std::swap(scores[current], scores[best]);
+                    const Move& m = moves[current++];
+                    if (!isSpecial(m)) {
+                        move = m;
+                        return true;
+                    }
+                }
+                stage = Stage::KILLERS;
+                break ;
+
+            case Stage::KILLERS:
+                while (killers != nullptr && killerIndex < kKillers) {
+                    const Move& killer = killers[killerIndex++];
+                    if (killer != hashMove && killer.type() == Move::Type::QUIET && board.isLegal(killer, color, checkInfo)) {
+                        move = killer;
+                        return true;
+                    }
+                }
+                stage = Stage::GENERATE_QUIETS;
+                break ;
+
+            case Stage::GENERATE_QUIETS:
+                moves.clear();
+                board.generateQuiets(moves, color, checkInfo);
+                current = 0;
+                stage = Stage::QUIETS;
+                break ;
+
+            case Stage::QUIETS:
+                while (current < moves.size()) {
+                    const Move& m = moves[current++];
+                    if (!isSpecial(m)) {
+                        move = m;
+                        return true;
+                    }
+                }
+                stage = Stage::DONE;
+                break ;
+
+            case Stage::DONE:
+                return false;
+        }
+    }
+}
+
 /** negamax implementation */
-TScore AIPlayer::negamax(Board& board, TTeam color, int depth, Move* result, clock_t maxTime, TScore alpha, TScore beta) {
+template<Color color>
+TScore AIPlayer::negamax(Board& board, int depth, Move* result, clock_t maxTime, TScore alpha, TScore beta) {
 
     TransTable& tt = color > 0 ? this->ttWhite : this->ttBlack;
 
-    // if the score was cached then return it...
-    TTEntry* cacheEntry = tt.lookup(board.getZobristHash(), depth);
-    if (cacheEntry != nullptr) {
-        return cacheEntry->score * color;
+    const uint64_t hash = board.getZobristHash();
+
+    // if the score was cached then return it... except at the root, which has to come back with a move
+    if (result == nullptr) {
+        TTEntry* cacheEntry = tt.lookup(hash, depth);
+        if (cacheEntry != nullptr) {
+            return cacheEntry->score * color;
+        }
     }
 
     if (depth == 0) {
-		return scoreFunc(board) * color;
+        // leaves reached through transpositions are scored once, the tt only holds interior nodes
+        TScore eval;
+        if (!evalCache.probe(hash, eval)) {
+            // the window is the side to move's, the score function works from white's point of view
+            bool exact;
+            eval = color > 0 ? scoreFunc(board, alpha, beta, exact) : scoreFunc(board, -beta, -alpha, exact);
+            if (exact)
+                evalCache.store(hash, eval);
+        }
+		return eval * color;
     }
 
     TScore max = -std::numeric_limits<TScore>::max();
 
-    Board::MoveList moves;
-    moves.reserve(120);
-    board.generateMoves(moves, color);
-
-    if (depth > 4) { // greater than 4 takes real time to process so we yield to give interrupts a chance.
-        for (auto move : moves) {
-            move.make(board, stack);
-            TTEntry* entry;
-            move.zobristHash = board.getZobristHash();
-            if ((entry = tt.lookup(move.zobristHash, 0)) != nullptr) {
-                move.score = entry->score;
-            } else {
-                move.score = board.getScore();
-            }
-            move.unmake(board, stack);
-        }
-
-        std::sort(moves.begin(), moves.end(), [=](const Move& moveA, const Move& moveB) {
-            return moveA.score * color < moveB.score * color;
-        });
-    }
+    // the hash move comes from any earlier search of this node, even a shallower one
+    TTEntry* hashEntry = tt.probe(hash);
+    MovePicker picker(board, color, hashEntry != nullptr ? hashEntry->move : Move(),
+                      depth < kMaxDepth ? killers[depth] : nullptr);
 
     if (depth >= 4) {
         if (maxTime < clock()) {
@@ -88,20 +198,35 @@ TScore AIPlayer::negamax(Board& board, TTeam color, int depth, Move* result, clo
         }
     }
 
-    for (Move& move : moves) {
-        move.make(board, stack);
-        TScore score = -this->negamax(board, -color, depth - 1, nullptr, maxTime, -beta, -alpha);
-        move.unmake(board, stack);
+    Move move;
+    Move bestMove;
+    int moveCount = 0;
+    while (picker.next(move)) {
+        moveCount++;
+#ifdef SEARCH_COPY_MAKE
+        Board child(board);
+        NullStateStack scratch;
+        move.make<color>(child, scratch);
+        TScore score = -this->negamax<opposite(color)>(child, depth - 1, nullptr, maxTime, -beta, -alpha);
+#else
+        move.make<color>(board, stack);
+        TScore score = -this->negamax<opposite(color)>(board, depth - 1, nullptr, maxTime, -beta, -alpha);
+        move.unmake<color>(board, stack);
+#endif
 
         if (score > max) {
             if (result)
                 *result = move;
+            bestMove = move;
             max = score;
         }
         if (score > alpha)
             alpha = score;
-        if (alpha >= beta)
+        if (alpha >= beta) {
+            if (move.type() == Move::Type::QUIET)
+                storeKiller(depth, move);
             break ;
+        }
     }
 
     if (depth >= 4) {
@@ -112,26 +237,47 @@ TScore AIPlayer::negamax(Board& board, TTeam color, int depth, Move* result, clo
         }
     }
 
-    tt.insert(board.getZobristHash(), depth, max * color);
+    // no legal moves, checkmate or stalemate. sooner mates (more depth left) score further from zero
+    if (moveCount == 0)
+        max = picker.inCheck() ? -(kScoreMate + depth) : 0;
+
+    tt.insert(hash, depth, max * color, bestMove);
 
     return max;
 }
 
+inline void AIPlayer::storeKiller(int depth, const Move& move) {
+    if (depth >= kMaxDepth || killers[depth][0] == move)
+        return ;
+    for (int i = MovePicker::kKillers - 1; i > 0; --i)
+        killers[depth][i] = killers[depth][i - 1];
+    killers[depth][0] = move;
+}
+
 
 TScore AIPlayer::pickBestMove(const Board &b, TTeam team, Move *result) {
     Board copy(b);
 
+    // copy-make children would all update the one accumulator, so the network needs make/unmake
+#ifndef SEARCH_COPY_MAKE
+    accumulator.network = defaultNetwork();
+    copy.attachAccumulator(accumulator.network != nullptr ? &accumulator : nullptr);
+#else
+    copy.attachAccumulator(nullptr);
+#endif
+
     const clock_t begin_time = clock();
 
     TScore score = 0;
-    Move::TMoveScratchStack stack;
     std::cout << "Begin search." << std::endl;
     int i = 3;
     while (true) {
         std::cout << "\tDepth: " << i << std::endl;
         Move curResult;
-        TScore curScore = this->negamax(copy, team, i, &curResult, begin_time + CLOCKS_PER_SEC * difficulty);
-        if (curResult.type != Move::Type::INVALID) {
+        const clock_t maxTime = begin_time + CLOCKS_PER_SEC * difficulty;
+        TScore curScore = team > 0 ? this->negamax<WHITE>(copy, i, &curResult, maxTime)
+                                   : this->negamax<BLACK>(copy, i, &curResult, maxTime);
+        if (curResult.type() != Move::Type::INVALID) {
             *result = curResult;
             score = curScore;
         } else {
@@ -144,146 +290,3 @@ TScore AIPlayer::pickBestMove(const Board &b, TTeam team, Move *result) {
 
     return score;
 }
-
-TScore ScoreFunction::operator() (const Board& board) {
-	// determine the piece counts
-	const int pc_offset = 8;
-	int piece_counts[pc_offset * 2] = {0}; // sufficiently large to hold all piece values.
-	for (int i = 0; i < BOARD_SIZE; ++i) {
-		TPiece piece = board[mailbox64[i]];
-		piece_counts[piece + 8]++;
-	}
-
-	// // game phase computation
-	// const int PawnPhase = 0;
-	// const int KnightPhase = 1;
-	// const int BishopPhase = 1;
-	// const int RookPhase = 2;
-	// const int QueenPhase = 4;
-	// const int TotalPhase = PawnPhase*16 + KnightPhase*4 + BishopPhase*4 + RookPhase*4 + QueenPhase*2;
-	//
-	// int phase = TotalPhase;
-	// phase -= (piece_counts[pc_offset + PIECE_PAWN] + piece_counts[pc_offset - PIECE_PAWN]) * PawnPhase;
-	// phase -= (piece_counts[pc_offset + PIECE_KNIGHT] + piece_counts[pc_offset - PIECE_KNIGHT]) * KnightPhase;
-	// phase -= (piece_counts[pc_offset + PIECE_BISHOP] + piece_counts[pc_offset - PIECE_BISHOP]) * BishopPhase;
-	// phase -= (piece_counts[pc_offset + PIECE_ROOK] + piece_counts[pc_offset - PIECE_ROOK]) * RookPhase;
-	// phase -= (piece_counts[pc_offset + PIECE_QUEEN] + piece_counts[pc_offset - PIECE_QUEEN]) * QueenPhase;
-	// phase = (phase * 256 + (TotalPhase / 2)) / TotalPhase;
-
-	TScore combined = 0;
-
-	TScore materialScore = board.getScore();
-
-	TScore duplicatePieceScore = 0;
-
-	if (piece_counts[pc_offset + PIECE_KNIGHT] > 1) {
-		duplicatePieceScore -= 40;
-	}
-	if (piece_counts[pc_offset - PIECE_KNIGHT] > 1) {
-		duplicatePieceScore += 40;
-	}
-
-    // int openness = 0;
-	// std::vector<Move> movesWhite;
-	// movesWhite.reserve(100);
-	// std::vector<Move> movesBlack;
-	// movesBlack.reserve(100);
-	// board.generateMoves(movesWhite, 1);
-	// board.generateMoves(movesBlack, -1);
-	// openness += (movesWhite.size() - movesBlack.size()); // TODO: modify openness bias.
-
-
-    int pawnProtection = 0;
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        TPiece piece = board[mailbox64[i]];
-        TTeam team = piece > 0 ? 1 : -1;
-        piece = abs(piece);
-        if (piece == PIECE_PAWN) {
-            if (board[mailbox64[i] + MAILBOX_W + 1] * team > 0)
-                pawnProtection++;
-            if (board[mailbox64[i] + MAILBOX_W - 1] * team > 0)
-                pawnProtection++;
-        }
-    }
-
-	combined += materialScore * materialMult;
-	combined += duplicatePieceScore * duplicatePieceMult;
-    // combined += openness * opennessMult;
-    combined += pawnProtection * pawnProtectionMult;
-
-	return materialScore;
-
-	//
-
-	//
-	// if (phase > 160) {
-	// 	// late game board evaluation
-	//
-	// 	TScore score = 0;
-	// 	int whiteKingPos = -1;
-	// 	int blackKingPos = -1;
-	// 	for (int i = 0; i < BOARD_SIZE; ++i) {
-	// 		TPiece piece = board[mailbox64[i]];
-	// 		switch (piece) {
-	// 		case PIECE_KING:
-	// 			whiteKingPos = i;
-	// 			break ;
-	// 		case -PIECE_KING:
-	// 			blackKingPos = i;
-	// 			break ;
-	// 		default:
-	// 			break ;
-	// 		}
-	// 	}
-	//
-	// 	{
-	// 		// KRK end game
-	// 		double whiteKingX = whiteKingPos % BOARD_DIM;
-	// 		double whiteKingY = whiteKingPos / BOARD_DIM;
-	// 		double blackKingX = blackKingPos % BOARD_DIM;
-	// 		double blackKingY = blackKingPos / BOARD_DIM;
-	//
-	// 		double cmd;
-	// 		double md = std::abs(whiteKingX - blackKingX) + std::abs(whiteKingY - blackKingY);
-	// 		if (materialScore < 0) {
-	// 			cmd = std::abs(BOARD_DIM / 2.0 - blackKingX);
-	// 			cmd += std::abs(BOARD_DIM / 2.0 - blackKingY);
-	// 		} else {
-	// 			cmd = std::abs(BOARD_DIM / 2 - whiteKingX);
-	// 			cmd += std::abs(BOARD_DIM / 2 - whiteKingY);
-	// 		}
-	//
-	// 		TScore mopupValue = 4.7 * cmd + 16 * (BOARD_DIM - 2 - md);
-	// 		score += (materialScore < 0 ? -mopupValue : mopupValue) * 50;
-	// 	}
-	//
-	// 	return score;
-	// } else {
-	// 	// pawn structure buff
-	// 	// TODO: determine if helping the AI understand pawn struCTUre is actually beneficial
-	// 	//       I think it helps break up opponent's pawn structure though it does not seem to help
-	// 	//       the AI form it's own.
-	// 	TScore score = 0;
-	// 	for (int i = 0; i < BOARD_SIZE; ++i) {
-	// 		const int pos = mailbox64[i];
-	// 		TPiece piece = board[pos];
-	// 		switch (piece) {
-	// 		case PIECE_PAWN:
-	// 			if (board[pos - MAILBOX_W + 1] == PIECE_PAWN)
-	// 				score += 5; // half a centipawn
-	// 			else if (board[pos - MAILBOX_W - 1] == PIECE_PAWN)
-	// 				score += 5; // half a centipawn
-	// 			break ;
-	// 		case -PIECE_PAWN:
-	// 			if (board[pos + MAILBOX_W + 1] == -PIECE_PAWN)
-	// 				score -= 5; // half a centipawn
-	// 			else if (board[pos + MAILBOX_W - 1] == -PIECE_PAWN)
-	// 				score -= 5; // half a centipawn
-	// 			break ;
-	// 		default:
-	// 			continue ;
-	// 		}
-	// 	}
-	// 	return score + materialScore;
-	// }
-}
@@ -9,21 +9,30 @@
 #ifndef intelligence_hpp
 #define intelligence_hpp
 
+// search by copying the board into each child instead of make/unmake, also settable from cmake
+//#define SEARCH_COPY_MAKE
+
+#include <atomic>
+
 #include "constants.hpp"
 #include "board.hpp"
+#include "evaluation.hpp"
 
 struct TTEntry {
     static const TScore kEmpty = std::numeric_limits<TScore>::max();
 
     uint64_t hash = 0;
-    int depth = 0;
     TScore score = kEmpty;
+    int16_t depth = 0;
+    Move move; // best move found at this node
 
     bool isEmpty() {
         return score == kEmpty;
     }
 };
 
+static_assert(sizeof(TTEntry) == 16, "transposition entries should stay at 16 bytes");
+
 class TransTable {
 private:
     const size_t size;
@@ -33,24 +42,93 @@ public:
     TransTable(size_t size);
     ~TransTable();
 
-    void insert(uint64_t hash, int depth, TScore score);
+    void insert(uint64_t hash, int depth, TScore score, const Move& bestMove);
     TTEntry* lookup(uint64_t hash, int depth) const;
+    TTEntry* probe(uint64_t hash) const; // any entry for hash, regardless of its depth
 };
 
+/**
+ lossy cache of static evaluations. each slot is one 64 bit word holding the
+ top half of the hash and the score, so a read can never see half of one
+ write and half of another, and no locking is needed if searches ever share it.
+ colliding positions simply overwrite each other.
+ */
+class EvalCache {
+private:
+    const size_t size; // a power of two
+    std::atomic<uint64_t>* table;
 
-class Player {
 public:
-    TScore pickBestMove(const Board& b, TTeam team, Move* result);
+    size_t probes = 0;
+    size_t hits = 0;
+
+    EvalCache(size_t size);
+    ~EvalCache();
+
+    inline bool probe(uint64_t hash, TScore& score) {
+        const uint64_t entry = table[hash & (size - 1)].load(std::memory_order_relaxed);
+        probes++;
+        if ((entry ^ hash) >> 32 != 0 || entry == 0)
+            return false;
+        hits++;
+        score = TScore(int32_t(uint32_t(entry)));
+        return true;
+    }
+
+    inline void store(uint64_t hash, TScore score) {
+        table[hash & (size - 1)].store((hash & 0xFFFFFFFF00000000ULL) | uint32_t(score), std::memory_order_relaxed);
+    }
 };
 
-struct ScoreFunction {
+/**
+ hands out the legal moves of a node one stage at a time: the hash move, then
+ captures by MVV-LVA, then killers, and quiets last. each stage is only
+ generated once the previous one is exhausted, so a node that cuts off on
+ the hash move or a capture never pays for generating its quiet moves.
+ */
+class MovePicker {
+public:
+    enum class Stage : uint8_t {
+        HASH_MOVE,
+        GENERATE_CAPTURES,
+        CAPTURES,
+        KILLERS,
+        GENERATE_QUIETS,
+        QUIETS,
+        DONE
+    };
+
+    static constexpr int kKillers = 2;
+
+private:
+    const Board& board;
+    const TTeam color;
+    const Move hashMove;
+    const Move* killers;
+    const Board::CheckInfo checkInfo;
+
+    Stage stage = Stage::HASH_MOVE;
+    int killerIndex = 0;
+    int current = 0;
+    Board::MoveList moves;
+    TScore scores[Board::MoveList::kCapacity]; // ordering scores, parallel to moves
+
+    bool isSpecial(const Move& move) const;
+
+public:
+    MovePicker(const Board& board, TTeam color, const Move& hashMove, const Move* killers);
+
+    // writes the next move to search into move, false once every move has been handed out
+    bool next(Move& move);
+
+    inline Stage getStage() const { return stage; }
+    inline bool inCheck() const { return checkInfo.checkers != 0; }
+};
 
-	double opennessMult = 7.0;
-	double materialMult = 1.0;
-	double duplicatePieceMult = 1.0;
-	double pawnProtectionMult = 15.0;
 
-	TScore operator() (const Board& board);
+class Player {
+public:
+    TScore pickBestMove(const Board& b, TTeam team, Move* result);
 };
 
 class AIPlayer {
@@ -58,20 +136,31 @@ private:
 	ScoreFunction scoreFunc;
 
     static constexpr double runTimeLimit = 2.0;
+    static constexpr int kMaxDepth = 64;
     int difficulty = 0;
     Move::TMoveScratchStack stack;
     TransTable ttWhite;
     TransTable ttBlack;
+    EvalCache evalCache;
+    Accumulator accumulator; // attached to the search board when a network is loaded
+    Move killers[kMaxDepth][MovePicker::kKillers];
+
+    void storeKiller(int depth, const Move& move);
 
-    TScore negamax(Board& board, TTeam color, int depth, Move* result = nullptr,
+    // specialized per side to move, pickBestMove dispatches on the TTeam once at the root
+    template<Color color>
+    TScore negamax(Board& board, int depth, Move* result = nullptr,
                    clock_t maxTime = clock() + CLOCKS_PER_SEC * runTimeLimit,
                    TScore alpha = -std::numeric_limits<TScore>::max(),
                    TScore beta = std::numeric_limits<TScore>::max()
                    );
 
 public:
-    AIPlayer(int difficulty = 7) : ttWhite(15485863), ttBlack(15485863), difficulty(difficulty) {};
+    AIPlayer(int difficulty = 7) : ttWhite(15485863), ttBlack(15485863), evalCache(1 << 16), difficulty(difficulty) {};
     TScore pickBestMove(const Board& b, TTeam team, Move* result);
+
+    inline const EvalCache& getEvalCache() const { return evalCache; }
+    inline const ScoreFunction& getScoreFunction() const { return scoreFunc; }
 };
 
 #endif /* intelligence_hpp */
@@ -9,13 +9,23 @@
 // good advice http://www.fam-petzke.de/cp_board_en.shtml
 
 #include <iostream>
+#include <cstring>
 
 #include "tests.hpp"
+#include "bench.hpp"
 #include "constants.hpp"
 #include "intelligence.hpp"
 #include "board.hpp"
 
 int main(int argc, const char * argv[]) {
+    std::cout << "Slider attacks: " << sliderBackendName(sliderBackend) << std::endl;
+    std::cout << "Network kernels: " << nnueBackendName(nnueBackend) << std::endl;
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        runBench();
+        return 0;
+    }
+
     std::cout << "Running test suite. " << std::endl;
     runTests();
     std::cout << "Testing complete. " << std::endl;
@@ -24,7 +34,6 @@ int main(int argc, const char * argv[]) {
     TTeam color = 1;
     Board board;
     AIPlayer player;
-    Move::TMoveScratchStack stack;
     
     board.setupBoard();
 
@@ -37,6 +46,8 @@ int main(int argc, const char * argv[]) {
         Move move;
         player.pickBestMove(board, color, &move);
         
+        // moves played in the match are never taken back, so their undo records can be dropped
+        Move::TMoveScratchStack stack;
         move.make(board, stack);
         std::cout << "\nTurn << " << turns << " Player: " << (color ? "WHITE" : "BLACK") << std::endl;
         std::cout << board.toString() << std::endl;
@@ -0,0 +1,97 @@
+//
+//  material.cpp
+//  engine
+//
+//  Created by Gareth George on 1/10/17.
+//  Copyright © 2017 Gareth George. All rights reserved.
+//
+
+#include <cstdlib>
+
+#include "material.hpp"
+
+MaterialEntry materialTable[kMaterialTableSize];
+const MaterialEntry kUnusualMaterial = {0, 0};
+
+// scores are in the board's units, a pawn is 1000
+static constexpr TScore kBishopPair = 300;
+static constexpr TScore kKnightPair = -40;
+
+// piece counts of one side, indexed by piece type
+struct SideMaterial {
+    int count[PIECE_KING + 1];
+
+    bool bare() const {
+        return count[PIECE_PAWN] + count[PIECE_KNIGHT] + count[PIECE_BISHOP] + count[PIECE_ROOK] + count[PIECE_QUEEN] == 0;
+    }
+
+    // enough to mate a bare king without pawns
+    bool canForceMate() const {
+        return count[PIECE_QUEEN] || count[PIECE_ROOK] || count[PIECE_BISHOP] >= 2 || (count[PIECE_BISHOP] && count[PIECE_KNIGHT]);
+    }
+
+    // a single minor piece, or two knights, can not win even against a bare king
+    bool cannotWin() const {
+        if (count[PIECE_PAWN] || count[PIECE_ROOK] || count[PIECE_QUEEN])
+            return false;
+        return count[PIECE_KNIGHT] + count[PIECE_BISHOP] <= 1 || (count[PIECE_KNIGHT] == 2 && !count[PIECE_BISHOP]);
+    }
+
+    TScore imbalance() const {
+        return (count[PIECE_BISHOP] >= 2 ? kBishopPair : 0) + (count[PIECE_KNIGHT] >= 2 ? kKnightPair : 0);
+    }
+};
+
+static SideMaterial decodeSide(int digits) {
+    SideMaterial side = {};
+    for (int type = PIECE_PAWN; type < PIECE_KING; ++type) {
+        side.count[type] = digits % (kMaterialCap[type] + 1);
+        digits /= kMaterialCap[type] + 1;
+    }
+    return side;
+}
+
+/**
+ filled at startup, the table is close to a megabyte so it is built here
+ rather than at compile time.
+ */
+struct __PopulateMaterialTable {
+    __PopulateMaterialTable() {
+        for (int key = 0; key < kMaterialTableSize; ++key) {
+            const SideMaterial white = decodeSide(key % kMaterialSide);
+            const SideMaterial black = decodeSide(key / kMaterialSide);
+
+            MaterialEntry& entry = materialTable[key];
+            entry.imbalance = white.imbalance() - black.imbalance();
+            entry.flags = 0;
+            if (white.cannotWin() && black.cannotWin())
+                entry.flags |= kMaterialDraw;
+            else if (black.bare() && !white.count[PIECE_PAWN] && white.canForceMate())
+                entry.flags |= kMaterialMopUpWhite;
+            else if (white.bare() && !black.count[PIECE_PAWN] && black.canForceMate())
+                entry.flags |= kMaterialMopUpBlack;
+        }
+    }
+};
+
+__PopulateMaterialTable __populateMaterialTable;
+
+// distance of a square from the central four squares, 0 to 6
+static inline int centerDistance(int square) {
+    const int row = square / BOARD_DIM, col = square % BOARD_DIM;
+    return (row < 4 ? 3 - row : row - 4) + (col < 4 ? 3 - col : col - 4);
+}
+
+TScore mopUpScore(const Board& board, uint8_t flags) {
+    if (!(flags & (kMaterialMopUpWhite | kMaterialMopUpBlack)))
+        return 0;
+
+    const TTeam winner = (flags & kMaterialMopUpWhite) ? 1 : -1;
+    if (!board.getPieces(PIECE_KING, 1) || !board.getPieces(PIECE_KING, -1))
+        return 0;
+    const int winningKing = bitScanForward(board.getPieces(PIECE_KING, winner));
+    const int losingKing = bitScanForward(board.getPieces(PIECE_KING, -winner));
+    const int kingDistance = abs(winningKing / BOARD_DIM - losingKing / BOARD_DIM) + abs(winningKing % BOARD_DIM - losingKing % BOARD_DIM);
+
+    return (50 * centerDistance(losingKing) + 20 * (14 - kingDistance)) * winner;
+}
@@ -0,0 +1,43 @@
+//
+//  material.hpp
+//  engine
+//
+//  Created by Gareth George on 1/10/17.
+//  Copyright © 2017 Gareth George. All rights reserved.
+//
+
+#ifndef material_hpp
+#define material_hpp
+
+#include <stdint.h>
+
+#include "constants.hpp"
+#include "board.hpp"
+
+// MaterialEntry flags
+constexpr uint8_t kMaterialDraw = 1 << 0; // neither side has mating material
+constexpr uint8_t kMaterialMopUpWhite = 1 << 1; // black has a bare king, white can force mate
+constexpr uint8_t kMaterialMopUpBlack = 1 << 2; // and the other way around
+
+/**
+ everything that depends only on how many of each piece are left, one entry
+ per material key. imbalance is from white's point of view.
+ */
+struct MaterialEntry {
+    int16_t imbalance;
+    uint8_t flags;
+};
+
+static_assert(sizeof(MaterialEntry) == 4, "material entries should stay at 4 bytes");
+
+extern MaterialEntry materialTable[kMaterialTableSize];
+extern const MaterialEntry kUnusualMaterial; // for boards whose material does not fit the key
+
+inline const MaterialEntry& probeMaterial(const Board& board) {
+    return board.hasMaterialKey() ? materialTable[board.getMaterialKey()] : kUnusualMaterial;
+}
+
+// pushes a bare king to the edge and brings the winning king closer, positive for white
+extern TScore mopUpScore(const Board& board, uint8_t flags);
+
+#endif /* material_hpp */
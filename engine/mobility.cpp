@@ -0,0 +1,150 @@
+//
+//  mobility.cpp
+//  engine
+//
+//  Created by Gareth George on 1/12/17.
+//  Copyright © 2017 Gareth George. All rights reserved.
+//
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAS_X86_POPCNT
+#endif
+
+#include "mobility.hpp"
+
+// per reachable square, by piece type. long range pieces see more squares so count less each
+static constexpr int kMobilityWeight[PIECE_KING + 1] = {0, 0, 4, 5, 3, 1, 0};
+
+// per attacked square next to the enemy king, by piece type
+static constexpr int kKingAttackWeight[PIECE_KING + 1] = {0, 0, 20, 20, 40, 80, 0};
+
+// percent of the attack weight that counts by number of attackers, one piece alone is rarely a threat
+static constexpr int kAttackerScale[8] = {0, 0, 50, 75, 88, 94, 97, 99};
+
+// per square next to the king the enemy attacks and only the king defends
+static constexpr int kWeakSquareWeight = 15;
+
+// what one side's pieces add up to before the other side is known
+struct SideActivity {
+    TScore mobility = 0;
+    int attackers = 0; // pieces hitting the enemy king zone
+    int attackWeight = 0;
+};
+
+template<TPiece Type>
+__attribute__((always_inline)) static inline TBitboard attacksFrom(int square, TBitboard occupied) {
+    switch (Type) {
+        case PIECE_KNIGHT: return knightAttackTable[square];
+        case PIECE_BISHOP: return bishopAttacks(square, occupied);
+        case PIECE_ROOK: return rookAttacks(square, occupied);
+        default: return queenAttacks(square, occupied);
+    }
+}
+
+// one loop per piece type so the attack lookup and weights are constants, king safety also fills the attack map
+template<bool WithMobility, bool WithKingSafety, TPiece Type>
+__attribute__((always_inline)) static inline void addPieces(TBitboard pieces, TBitboard occupied, TBitboard available, TBitboard kingZone,
+                                                           int side, AttackMap& map, SideActivity& activity) {
+    while (pieces) {
+        const TBitboard attacks = attacksFrom<Type>(popLsb(pieces), occupied);
+        if (WithMobility)
+            activity.mobility += kMobilityWeight[Type] * popCount(attacks & available);
+        if (WithKingSafety) {
+            const int zoneHits = popCount(attacks & kingZone);
+            activity.attackers += zoneHits != 0;
+            activity.attackWeight += kKingAttackWeight[Type] * zoneHits;
+            map.add(side, attacks);
+        }
+    }
+}
+
+template<bool WithMobility, bool WithKingSafety, Color Player>
+__attribute__((always_inline)) static inline void evaluateSide(const Board& board, AttackMap& map, SideActivity& activity) {
+    const int side = teamIndex(Player);
+    const TBitboard occupied = board.getOccupied();
+    const TBitboard enemyPawns = board.getPieces(PIECE_PAWN, -Player);
+    const TBitboard pawnCover = Player == WHITE ? shiftSouthEast(enemyPawns) | shiftSouthWest(enemyPawns)
+                                                : shiftNorthEast(enemyPawns) | shiftNorthWest(enemyPawns);
+    const TBitboard available = ~board.getTeamPieces(Player) & ~pawnCover;
+
+    const TBitboard enemyKing = board.getPieces(PIECE_KING, -Player);
+    const TBitboard kingZone = WithKingSafety && enemyKing ? kingAttackTable[bitScanForward(enemyKing)] | enemyKing : 0;
+
+    addPieces<WithMobility, WithKingSafety, PIECE_KNIGHT>(board.getPieces(PIECE_KNIGHT, Player), occupied, available, kingZone, side, map, activity);
+    addPieces<WithMobility, WithKingSafety, PIECE_BISHOP>(board.getPieces(PIECE_BISHOP, Player), occupied, available, kingZone, side, map, activity);
+    addPieces<WithMobility, WithKingSafety, PIECE_ROOK>(board.getPieces(PIECE_ROOK, Player), occupied, available, kingZone, side, map, activity);
+    addPieces<WithMobility, WithKingSafety, PIECE_QUEEN>(board.getPieces(PIECE_QUEEN, Player), occupied, available, kingZone, side, map, activity);
+
+    if (WithKingSafety) {
+        // pawns and king go in whole, a square both pawns hit counts twice
+        const TBitboard pawns = board.getPieces(PIECE_PAWN, Player);
+        map.add(side, Player == WHITE ? shiftNorthEast(pawns) : shiftSouthEast(pawns));
+        map.add(side, Player == WHITE ? shiftNorthWest(pawns) : shiftSouthWest(pawns));
+        const TBitboard king = board.getPieces(PIECE_KING, Player);
+        if (king)
+            map.add(side, kingAttackTable[bitScanForward(king)]);
+    }
+}
+
+// needs both sides in the attack map, the king covers its whole ring so a second defender means a real one
+template<Color Player>
+__attribute__((always_inline)) static inline TScore kingAttack(const Board& board, const AttackMap& map, SideActivity activity) {
+    const TBitboard enemyKing = board.getPieces(PIECE_KING, -Player);
+    if (!enemyKing)
+        return 0;
+    const TBitboard weak = kingAttackTable[bitScanForward(enemyKing)] & map.attacked[teamIndex(Player)] &
+                           ~map.attackedTwice[teamIndex(-Player)];
+    activity.attackWeight += kWeakSquareWeight * popCount(weak);
+    return activity.attackWeight * kAttackerScale[activity.attackers < 7 ? activity.attackers : 7] / 100;
+}
+
+template<bool WithMobility, bool WithKingSafety>
+__attribute__((always_inline)) static inline Mobility evaluateBothSides(const Board& board) {
+    AttackMap map;
+    SideActivity white, black;
+    evaluateSide<WithMobility, WithKingSafety, WHITE>(board, map, white);
+    evaluateSide<WithMobility, WithKingSafety, BLACK>(board, map, black);
+
+    Mobility result;
+    result.mobility = white.mobility - black.mobility;
+    if (WithKingSafety)
+        result.kingSafety = kingAttack<WHITE>(board, map, white) - kingAttack<BLACK>(board, map, black);
+    return result;
+}
+
+AttackMap buildAttackMap(const Board& board) {
+    AttackMap map;
+    SideActivity white, black;
+    evaluateSide<false, true, WHITE>(board, map, white);
+    evaluateSide<false, true, BLACK>(board, map, black);
+    return map;
+}
+
+/*
+ nearly all of the work is popcounts, which without the instruction are a
+ libgcc call each. the same code is compiled again for POPCNT and picked once
+ from cpuid, like the slider kernels, so the build flags can stay generic.
+ the helpers above are forced inline so they get compiled into both versions.
+ */
+#ifdef HAS_X86_POPCNT
+template<bool WithMobility, bool WithKingSafety>
+__attribute__((target("popcnt"))) static Mobility evaluateMobilityPopcnt(const Board& board) {
+    return evaluateBothSides<WithMobility, WithKingSafety>(board);
+}
+
+static const bool hasPopcnt = __builtin_cpu_supports("popcnt");
+#endif
+
+template<bool WithMobility, bool WithKingSafety>
+Mobility evaluateMobility(const Board& board) {
+#ifdef HAS_X86_POPCNT
+    if (hasPopcnt)
+        return evaluateMobilityPopcnt<WithMobility, WithKingSafety>(board);
+#endif
+    return evaluateBothSides<WithMobility, WithKingSafety>(board);
+}
+
+template Mobility evaluateMobility<true, true>(const Board& board);
+template Mobility evaluateMobility<true, false>(const Board& board);
+template Mobility evaluateMobility<false, true>(const Board& board);
+template Mobility evaluateMobility<false, false>(const Board& board);
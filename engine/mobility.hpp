@@ -0,0 +1,54 @@
+//
+//  mobility.hpp
+//  engine
+//
+//  Created by Gareth George on 1/12/17.
+//  Copyright © 2017 Gareth George. All rights reserved.
+//
+
+#ifndef mobility_hpp
+#define mobility_hpp
+
+#include "constants.hpp"
+#include "board.hpp"
+
+/**
+ piece activity from white's point of view, read straight off the attack
+ bitboards with popcounts, no move lists are built. mobility counts the
+ squares each knight, bishop, rook and queen reaches that are neither held by
+ its own side nor covered by enemy pawns. king safety charges each side for
+ the enemy pieces hitting the squares around its king, and grows quickly with
+ the number of pieces joining in, and more when the squares they hit have
+ nothing but the king to defend them.
+ */
+struct Mobility {
+    TScore mobility = 0;
+    TScore kingSafety = 0;
+};
+
+/**
+ squares each side attacks at least once and at least twice, by teamIndex.
+ built at eval time in the same pass as king safety rather than kept by the
+ board, updating it in setPiece cost more in make/unmake than it saved here.
+ */
+struct AttackMap {
+    TBitboard attacked[2] = {0, 0};
+    TBitboard attackedTwice[2] = {0, 0};
+
+    inline void add(int side, TBitboard attacks) {
+        attackedTwice[side] |= attacked[side] & attacks;
+        attacked[side] |= attacks;
+    }
+};
+
+AttackMap buildAttackMap(const Board& board);
+
+// either half can be left out at compile time, the other field is then 0
+template<bool WithMobility, bool WithKingSafety>
+Mobility evaluateMobility(const Board& board);
+
+inline Mobility evaluateMobility(const Board& board) {
+    return evaluateMobility<true, true>(board);
+}
+
+#endif /* mobility_hpp */
@@ -0,0 +1,403 @@
+//
+//  nnue.cpp
+//  engine
+//
+//  Created by Gareth George on 1/11/17.
+//  Copyright © 2017 Gareth George. All rights reserved.
+//
+
+#include <fstream>
+#include <random>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAS_X86_SIMD
+#endif
+
+#include "nnue.hpp"
+
+using namespace nnue;
+
+NNUEBackend nnueBackend = NNUEBackend::SCALAR;
+
+/*
+ network files
+ */
+
+template<typename T>
+static bool readArray(std::ifstream& in, T* data, size_t count) {
+    return bool(in.read(reinterpret_cast<char*>(data), sizeof(T) * count));
+}
+
+template<typename T>
+static bool writeArray(std::ofstream& out, const T* data, size_t count) {
+    return bool(out.write(reinterpret_cast<const char*>(data), sizeof(T) * count));
+}
+
+bool Network::load(const char* path) {
+    std::ifstream in(path, std::ios::binary);
+    uint32_t header[2] = {0};
+    if (!readArray(in, header, 2) || header[0] != kMagic || header[1] != kVersion)
+        return false;
+
+    const bool ok = readArray(in, &featureWeights[0][0], kFeatures * kHidden) &&
+                    readArray(in, featureBias, kHidden) &&
+                    readArray(in, &layer1Weights[0][0], kLayer1 * 2 * kHidden) &&
+                    readArray(in, layer1Bias, kLayer1) &&
+                    readArray(in, &layer2Weights[0][0], kLayer2 * kLayer1) &&
+                    readArray(in, layer2Bias, kLayer2) &&
+                    readArray(in, outputWeights, kLayer2) &&
+                    readArray(in, &outputBias, 1);
+    // trailing bytes mean the file was written for some other shape
+    return ok && in.peek() == std::ifstream::traits_type::eof();
+}
+
+bool Network::save(const char* path) const {
+    std::ofstream out(path, std::ios::binary);
+    const uint32_t header[2] = {kMagic, kVersion};
+    return writeArray(out, header, 2) &&
+           writeArray(out, &featureWeights[0][0], kFeatures * kHidden) &&
+           writeArray(out, featureBias, kHidden) &&
+           writeArray(out, &layer1Weights[0][0], kLayer1 * 2 * kHidden) &&
+           writeArray(out, layer1Bias, kLayer1) &&
+           writeArray(out, &layer2Weights[0][0], kLayer2 * kLayer1) &&
+           writeArray(out, layer2Bias, kLayer2) &&
+           writeArray(out, outputWeights, kLayer2) &&
+           writeArray(out, &outputBias, 1);
+}
+
+void Network::randomize(uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    auto uniform = [&rng](int low, int high) {
+        return low + int(rng() % uint64_t(high - low + 1));
+    };
+
+    for (int i = 0; i < kFeatures; ++i)
+        for (int j = 0; j < kHidden; ++j)
+            featureWeights[i][j] = int16_t(uniform(-8, 8));
+    for (int j = 0; j < kHidden; ++j)
+        featureBias[j] = int16_t(uniform(0, 32));
+    for (int i = 0; i < kLayer1; ++i) {
+        for (int j = 0; j < 2 * kHidden; ++j)
+            layer1Weights[i][j] = int8_t(uniform(-32, 32));
+        layer1Bias[i] = uniform(-1024, 1024);
+    }
+    for (int i = 0; i < kLayer2; ++i) {
+        for (int j = 0; j < kLayer1; ++j)
+            layer2Weights[i][j] = int8_t(uniform(-64, 64));
+        layer2Bias[i] = uniform(-1024, 1024);
+    }
+    for (int i = 0; i < kLayer2; ++i)
+        outputWeights[i] = int8_t(uniform(-127, 127));
+    outputBias = 0;
+}
+
+/*
+ kernels. every backend has to give bit for bit the same results, the tests
+ compare them against the scalar one. the AVX2 and SSSE3 versions are compiled
+ for their instruction sets regardless of the build flags and must only be
+ called once nnueBackendSupported has been checked.
+ */
+
+static void addColumnScalar(int16_t* acc, const int16_t* column) {
+    for (int i = 0; i < kHidden; ++i)
+        acc[i] = int16_t(acc[i] + column[i]);
+}
+
+static void subColumnScalar(int16_t* acc, const int16_t* column) {
+    for (int i = 0; i < kHidden; ++i)
+        acc[i] = int16_t(acc[i] - column[i]);
+}
+
+static void clipScalar(const int16_t* in, uint8_t* out, int count) {
+    for (int i = 0; i < count; ++i)
+        out[i] = uint8_t(in[i] < 0 ? 0 : in[i] > kClipMax ? kClipMax : in[i]);
+}
+
+static int32_t dot(const uint8_t* in, const int8_t* weights, int count) {
+    int32_t sum = 0;
+    for (int i = 0; i < count; ++i)
+        sum += int32_t(in[i]) * weights[i];
+    return sum;
+}
+
+// out = bias + weights * in, weights is outputs rows of inputs each
+static void affineScalar(const uint8_t* in, const int8_t* weights, const int32_t* bias, int32_t* out, int inputs, int outputs) {
+    for (int o = 0; o < outputs; ++o)
+        out[o] = bias[o] + dot(in, weights + o * inputs, inputs);
+}
+
+#ifdef HAS_X86_SIMD
+__attribute__((target("avx2"))) static void addColumnAVX2(int16_t* acc, const int16_t* column) {
+    for (int i = 0; i < kHidden; i += 16) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_add_epi16(a, c));
+    }
+}
+
+__attribute__((target("avx2"))) static void subColumnAVX2(int16_t* acc, const int16_t* column) {
+    for (int i = 0; i < kHidden; i += 16) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_sub_epi16(a, c));
+    }
+}
+
+// count is a multiple of 32
+__attribute__((target("avx2"))) static void clipAVX2(const int16_t* in, uint8_t* out, int count) {
+    const __m256i zero = _mm256_setzero_si256();
+    for (int i = 0; i < count; i += 32) {
+        const __m256i a = _mm256_max_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)), zero);
+        const __m256i b = _mm256_max_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 16)), zero);
+        // the pack saturates at 127 but works per 128 bit lane, the permute puts the lanes back in order
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+    }
+}
+
+/**
+ four rows at a time so each input load is shared, the horizontal adds then
+ fold the four row sums into one vector. inputs is a multiple of 32 and
+ outputs of 4. inputs are at most 127 so the pairwise int16 sums can't saturate.
+ */
+__attribute__((target("avx2"))) static void affineAVX2(const uint8_t* in, const int8_t* weights, const int32_t* bias, int32_t* out, int inputs, int outputs) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (int o = 0; o < outputs; o += 4) {
+        const int8_t* row = weights + o * inputs;
+        __m256i sums[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+        for (int i = 0; i < inputs; i += 32) {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            for (int r = 0; r < 4; ++r) {
+                const __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + r * inputs + i));
+                sums[r] = _mm256_add_epi32(sums[r], _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+            }
+        }
+        const __m256i folded = _mm256_hadd_epi32(_mm256_hadd_epi32(sums[0], sums[1]), _mm256_hadd_epi32(sums[2], sums[3]));
+        __m128i result = _mm_add_epi32(_mm256_castsi256_si128(folded), _mm256_extracti128_si256(folded, 1));
+        result = _mm_add_epi32(result, _mm_loadu_si128(reinterpret_cast<const __m128i*>(bias + o)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), result);
+    }
+}
+
+__attribute__((target("ssse3"))) static void addColumnSSSE3(int16_t* acc, const int16_t* column) {
+    for (int i = 0; i < kHidden; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), _mm_add_epi16(a, c));
+    }
+}
+
+__attribute__((target("ssse3"))) static void subColumnSSSE3(int16_t* acc, const int16_t* column) {
+    for (int i = 0; i < kHidden; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), _mm_sub_epi16(a, c));
+    }
+}
+
+// count is a multiple of 16
+__attribute__((target("ssse3"))) static void clipSSSE3(const int16_t* in, uint8_t* out, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < count; i += 16) {
+        const __m128i a = _mm_max_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), zero);
+        const __m128i b = _mm_max_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8)), zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi16(a, b));
+    }
+}
+
+// inputs is a multiple of 16 and outputs of 4
+__attribute__((target("ssse3"))) static void affineSSSE3(const uint8_t* in, const int8_t* weights, const int32_t* bias, int32_t* out, int inputs, int outputs) {
+    const __m128i ones = _mm_set1_epi16(1);
+    for (int o = 0; o < outputs; o += 4) {
+        const int8_t* row = weights + o * inputs;
+        __m128i sums[4] = {_mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128()};
+        for (int i = 0; i < inputs; i += 16) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            for (int r = 0; r < 4; ++r) {
+                const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + r * inputs + i));
+                sums[r] = _mm_add_epi32(sums[r], _mm_madd_epi16(_mm_maddubs_epi16(x, w), ones));
+            }
+        }
+        __m128i result = _mm_hadd_epi32(_mm_hadd_epi32(sums[0], sums[1]), _mm_hadd_epi32(sums[2], sums[3]));
+        result = _mm_add_epi32(result, _mm_loadu_si128(reinterpret_cast<const __m128i*>(bias + o)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), result);
+    }
+}
+#endif
+
+static inline void addColumn(int16_t* acc, const int16_t* column) {
+#ifdef HAS_X86_SIMD
+    switch (nnueBackend) {
+        case NNUEBackend::AVX2: return addColumnAVX2(acc, column);
+        case NNUEBackend::SSSE3: return addColumnSSSE3(acc, column);
+        default: break;
+    }
+#endif
+    addColumnScalar(acc, column);
+}
+
+static inline void subColumn(int16_t* acc, const int16_t* column) {
+#ifdef HAS_X86_SIMD
+    switch (nnueBackend) {
+        case NNUEBackend::AVX2: return subColumnAVX2(acc, column);
+        case NNUEBackend::SSSE3: return subColumnSSSE3(acc, column);
+        default: break;
+    }
+#endif
+    subColumnScalar(acc, column);
+}
+
+static inline void clip(const int16_t* in, uint8_t* out, int count) {
+#ifdef HAS_X86_SIMD
+    switch (nnueBackend) {
+        case NNUEBackend::AVX2: return clipAVX2(in, out, count);
+        case NNUEBackend::SSSE3: return clipSSSE3(in, out, count);
+        default: break;
+    }
+#endif
+    clipScalar(in, out, count);
+}
+
+static inline void affine(const uint8_t* in, const int8_t* weights, const int32_t* bias, int32_t* out, int inputs, int outputs) {
+#ifdef HAS_X86_SIMD
+    switch (nnueBackend) {
+        case NNUEBackend::AVX2: return affineAVX2(in, weights, bias, out, inputs, outputs);
+        case NNUEBackend::SSSE3: return affineSSSE3(in, weights, bias, out, inputs, outputs);
+        default: break;
+    }
+#endif
+    affineScalar(in, weights, bias, out, inputs, outputs);
+}
+
+/*
+ accumulator
+ */
+
+// own pieces first then the opponent's, black's perspective also flips the board
+static inline int featureIndex(int perspective, TPiece piece, int square) {
+    const bool own = (piece > 0) == (perspective == 0);
+    const int relative = perspective == 0 ? square : square ^ 56;
+    return ((own ? 0 : 6) + abs(piece) - 1) * BOARD_SIZE + relative;
+}
+
+void Accumulator::refresh(const TPiece* pieces) {
+    for (int perspective = 0; perspective < 2; ++perspective) {
+        memcpy(values[perspective], network->featureBias, sizeof(values[perspective]));
+        for (int square = 0; square < BOARD_SIZE; ++square) {
+            if (pieces[square] != 0)
+                addColumn(values[perspective], network->featureWeights[featureIndex(perspective, pieces[square], square)]);
+        }
+    }
+}
+
+void Accumulator::addPiece(TPiece piece, int square) {
+    addColumn(values[0], network->featureWeights[featureIndex(0, piece, square)]);
+    addColumn(values[1], network->featureWeights[featureIndex(1, piece, square)]);
+}
+
+void Accumulator::removePiece(TPiece piece, int square) {
+    subColumn(values[0], network->featureWeights[featureIndex(0, piece, square)]);
+    subColumn(values[1], network->featureWeights[featureIndex(1, piece, square)]);
+}
+
+// int32 layer outputs back to int8 activations
+static inline void activate(const int32_t* in, uint8_t* out, int count) {
+    for (int i = 0; i < count; ++i) {
+        const int32_t v = in[i] >> kWeightShift;
+        out[i] = uint8_t(v < 0 ? 0 : v > kClipMax ? kClipMax : v);
+    }
+}
+
+TScore Accumulator::evaluate() const {
+    alignas(32) uint8_t input[2 * kHidden];
+    clip(values[0], input, kHidden);
+    clip(values[1], input + kHidden, kHidden);
+
+    int32_t sums[kLayer1];
+    alignas(32) uint8_t hidden1[kLayer1];
+    affine(input, &network->layer1Weights[0][0], network->layer1Bias, sums, 2 * kHidden, kLayer1);
+    activate(sums, hidden1, kLayer1);
+
+    alignas(32) uint8_t hidden2[kLayer2];
+    affine(hidden1, &network->layer2Weights[0][0], network->layer2Bias, sums, kLayer1, kLayer2);
+    activate(sums, hidden2, kLayer2);
+
+    // a single output isn't worth a vector kernel
+    return (network->outputBias + dot(hidden2, network->outputWeights, kLayer2)) / kOutputScale;
+}
+
+/*
+ backend selection
+ */
+
+const char* nnueBackendName(NNUEBackend backend) {
+    switch (backend) {
+        case NNUEBackend::AVX2: return "avx2";
+        case NNUEBackend::SSSE3: return "ssse3";
+        case NNUEBackend::SCALAR: return "scalar";
+    }
+    return "?";
+}
+
+bool nnueBackendSupported(NNUEBackend backend) {
+#ifdef HAS_X86_SIMD
+    if (backend == NNUEBackend::AVX2)
+        return __builtin_cpu_supports("avx2");
+    if (backend == NNUEBackend::SSSE3)
+        return __builtin_cpu_supports("ssse3");
+#else
+    if (backend != NNUEBackend::SCALAR)
+        return false;
+#endif
+    return true;
+}
+
+NNUEBackend detectNNUEBackend() {
+    // CHESS_NNUE_SIMD=avx2|ssse3|scalar overrides the cpuid based choice
+    const char* forced = getenv("CHESS_NNUE_SIMD");
+    if (forced != nullptr) {
+        for (NNUEBackend backend : {NNUEBackend::AVX2, NNUEBackend::SSSE3, NNUEBackend::SCALAR}) {
+            if (strcmp(forced, nnueBackendName(backend)) == 0 && nnueBackendSupported(backend))
+                return backend;
+        }
+    }
+
+    for (NNUEBackend backend : {NNUEBackend::AVX2, NNUEBackend::SSSE3}) {
+        if (nnueBackendSupported(backend))
+            return backend;
+    }
+    return NNUEBackend::SCALAR;
+}
+
+bool setNNUEBackend(NNUEBackend backend) {
+    if (!nnueBackendSupported(backend))
+        return false;
+    nnueBackend = backend;
+    return true;
+}
+
+struct __SelectNNUEBackend {
+    __SelectNNUEBackend() {
+        setNNUEBackend(detectNNUEBackend());
+    }
+};
+
+__SelectNNUEBackend __selectNNUEBackend;
+
+const Network* defaultNetwork() {
+    static const std::unique_ptr<Network> network = []() {
+        std::unique_ptr<Network> loaded;
+        const char* path = getenv("CHESS_NNUE");
+        if (path != nullptr) {
+            loaded.reset(new Network());
+            if (!loaded->load(path))
+                loaded.reset();
+        }
+        return loaded;
+    }();
+    return network.get();
+}
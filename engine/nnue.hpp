@@ -0,0 +1,101 @@
+//
+//  nnue.hpp
+//  engine
+//
+//  Created by Gareth George on 1/11/17.
+//  Copyright © 2017 Gareth George. All rights reserved.
+//
+
+#ifndef nnue_hpp
+#define nnue_hpp
+
+#include <stdint.h>
+#include <cstddef>
+
+#include "constants.hpp"
+
+/**
+ efficiently updatable network, 768 -> 256x2 -> 32 -> 32 -> 1.
+
+ the inputs are one feature per (piece, square), seen from each side: white's
+ perspective as is, black's with the colors swapped and the board flipped. the
+ first layer is a sum of weight columns over the pieces on the board, so it is
+ kept as an accumulator the board updates in setPiece as pieces come and go.
+ only the small layers after it are evaluated per node, in int8 with int32 sums.
+
+ the output is from white's point of view like the rest of the evaluation, so
+ the two halves are always fed white first rather than side to move first.
+ */
+namespace nnue {
+    constexpr int kFeatures = 12 * BOARD_SIZE;
+    constexpr int kHidden = 256; // per perspective
+    constexpr int kLayer1 = 32;
+    constexpr int kLayer2 = 32;
+
+    constexpr int kClipMax = 127; // clipped relu range of the int8 activations
+    constexpr int kWeightShift = 6; // int8 weights are fixed point with 6 fractional bits
+    constexpr int kOutputScale = 16; // network output units per board score unit
+
+    // file header, followed by the parameters in the order they are declared in Network
+    constexpr uint32_t kMagic = 0x45554E4E; // "NNUE"
+    constexpr uint32_t kVersion = 1;
+}
+
+struct Network {
+    int16_t featureWeights[nnue::kFeatures][nnue::kHidden];
+    int16_t featureBias[nnue::kHidden];
+    int8_t layer1Weights[nnue::kLayer1][2 * nnue::kHidden];
+    int32_t layer1Bias[nnue::kLayer1];
+    int8_t layer2Weights[nnue::kLayer2][nnue::kLayer1];
+    int32_t layer2Bias[nnue::kLayer2];
+    int8_t outputWeights[nnue::kLayer2];
+    int32_t outputBias;
+
+    // little endian raw parameters behind the header, false if the file is missing or the wrong shape
+    bool load(const char* path);
+    bool save(const char* path) const;
+
+    // small random weights, for tests and benchmarks when no trained file is around
+    void randomize(uint64_t seed);
+};
+
+/**
+ first layer sums for both perspectives. the board holds a pointer to one
+ while a network is in use and keeps it current on every piece change; add and
+ remove are exact inverses so unmake can walk it back the same way.
+ */
+struct Accumulator {
+    int16_t values[2][nnue::kHidden]; // [white, black perspective]
+    const Network* network = nullptr;
+
+    // recomputes from scratch, pieces indexed by 64 square index
+    void refresh(const TPiece* pieces);
+
+    void addPiece(TPiece piece, int square);
+    void removePiece(TPiece piece, int square);
+
+    // the network's score for the position, from white's point of view
+    TScore evaluate() const;
+};
+
+/**
+ kernels for the accumulator updates and the int8 layers. like the slider
+ backend it is picked once at startup from cpuid, CHESS_NNUE_SIMD overrides.
+ */
+enum class NNUEBackend : uint8_t {
+    AVX2,
+    SSSE3,
+    SCALAR
+};
+
+extern NNUEBackend nnueBackend;
+
+extern const char* nnueBackendName(NNUEBackend backend);
+extern bool nnueBackendSupported(NNUEBackend backend);
+extern NNUEBackend detectNNUEBackend();
+extern bool setNNUEBackend(NNUEBackend backend);
+
+// the network named by CHESS_NNUE, loaded on first use. nullptr keeps the hand written evaluation
+extern const Network* defaultNetwork();
+
+#endif /* nnue_hpp */
@@ -0,0 +1,96 @@
+//
+//  pawns.cpp
+//  engine
+//
+//  Created by Gareth George on 1/10/17.
+//  Copyright © 2017 Gareth George. All rights reserved.
+//
+
+#include "pawns.hpp"
+#include "bitboard.hpp"
+
+// scores are in the board's units, a pawn is 1000
+static constexpr TScore kPassedBonus[BOARD_DIM] = {0, 50, 100, 150, 250, 400, 600, 0}; // by rank from the pawn's side
+static constexpr TScore kIsolatedPenalty = 120;
+static constexpr TScore kDoubledPenalty = 100;
+static constexpr TScore kBackwardPenalty = 80;
+static constexpr TScore kDefendedBonus = 30;
+
+/*
+ every term works on all of a side's pawns at once with shifts and fills
+ over the pawn bitboards, only the passed pawns are walked for their rank.
+ */
+
+static inline TBitboard northFill(TBitboard bb) {
+    bb |= bb << 8;
+    bb |= bb << 16;
+    return bb | bb << 32;
+}
+
+static inline TBitboard southFill(TBitboard bb) {
+    bb |= bb >> 8;
+    bb |= bb >> 16;
+    return bb | bb >> 32;
+}
+
+// every square in front of the pawns, towards the enemy
+template<Color Player>
+static inline TBitboard frontSpan(TBitboard pawns) {
+    return Player == WHITE ? northFill(shiftNorth(pawns)) : southFill(shiftSouth(pawns));
+}
+
+// the pawns' squares and every square behind them
+template<Color Player>
+static inline TBitboard rearFill(TBitboard pawns) {
+    return Player == WHITE ? southFill(pawns) : northFill(pawns);
+}
+
+template<Color Player>
+static inline TBitboard pawnAttacks(TBitboard pawns) {
+    return Player == WHITE ? shiftNorthEast(pawns) | shiftNorthWest(pawns) : shiftSouthEast(pawns) | shiftSouthWest(pawns);
+}
+
+static inline TBitboard sideways(TBitboard bb) {
+    return shiftEast(bb) | shiftWest(bb);
+}
+
+template<Color Player>
+static TScore evaluateSide(const Board& board) {
+    const TBitboard own = board.getPieces(PIECE_PAWN, Player);
+    const TBitboard enemy = board.getPieces(PIECE_PAWN, -Player);
+
+    // a pawn with another of ours in front of it, once per extra pawn on the file
+    const TBitboard doubled = own & frontSpan<Player>(own);
+    // no friendly pawn on either neighbouring file
+    const TBitboard isolated = own & ~sideways(northFill(own) | southFill(own));
+    // a neighbour level with or behind it could still come up to support it
+    const TBitboard supportable = own & sideways(rearFill<opposite(Player)>(own));
+    // neither supportable nor free to advance, the stop square is covered by an enemy pawn
+    const TBitboard backward = own & ~isolated & ~supportable &
+                               (Player == WHITE ? shiftSouth(pawnAttacks<BLACK>(enemy)) : shiftNorth(pawnAttacks<WHITE>(enemy)));
+    const TBitboard defended = own & pawnAttacks<Player>(own);
+
+    TScore score = kDefendedBonus * popCount(defended) - kDoubledPenalty * popCount(doubled) -
+                   kIsolatedPenalty * popCount(isolated) - kBackwardPenalty * popCount(backward);
+
+    // no enemy pawn ahead on the same or a neighbouring file
+    const TBitboard enemySpan = frontSpan<opposite(Player)>(enemy);
+    TBitboard passed = own & ~(enemySpan | sideways(enemySpan));
+    while (passed) {
+        const int square = popLsb(passed);
+        score += kPassedBonus[Player == WHITE ? square / BOARD_DIM : BOARD_DIM - 1 - square / BOARD_DIM];
+    }
+    return score;
+}
+
+TScore evaluatePawns(const Board& board) {
+    return evaluateSide<WHITE>(board) - evaluateSide<BLACK>(board);
+}
+
+PawnTable::PawnTable(size_t size) : size(size) {
+    this->table = new PawnEntry[size];
+}
+
+PawnTable::~PawnTable() {
+    delete[] table;
+}
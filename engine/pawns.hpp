@@ -0,0 +1,57 @@
+//
+//  pawns.hpp
+//  engine
+//
+//  Created by Gareth George on 1/10/17.
+//  Copyright © 2017 Gareth George. All rights reserved.
+//
+
+#ifndef pawns_hpp
+#define pawns_hpp
+
+#include <stdint.h>
+#include <cstddef>
+
+#include "constants.hpp"
+#include "board.hpp"
+
+/**
+ pawn structure terms (passed, isolated, doubled, backward and pawns
+ defended by pawns) from white's point of view. only depends on where the
+ pawns are, so it is cached by the board's pawn key.
+ */
+extern TScore evaluatePawns(const Board& board);
+
+struct PawnEntry {
+    uint64_t key = 0;
+    TScore score = 0; // the empty key is the pawnless board, which does score 0
+};
+
+class PawnTable {
+private:
+    const size_t size; // a power of two
+    PawnEntry* table;
+
+public:
+    size_t probes = 0;
+    size_t hits = 0;
+
+    PawnTable(size_t size);
+    ~PawnTable();
+
+    // the pawn structure score for board, evaluated only when the pawns are not already cached
+    inline TScore probe(const Board& board) {
+        const uint64_t key = board.getPawnHash();
+        PawnEntry& entry = table[key & (size - 1)];
+        probes++;
+        if (entry.key == key) {
+            hits++;
+            return entry.score;
+        }
+        entry.key = key;
+        entry.score = evaluatePawns(board);
+        return entry.score;
+    }
+};
+
+#endif /* pawns_hpp */
@@ -9,6 +9,12 @@
 #ifndef tests_hpp
 #define tests_hpp
 
+#include <cstddef>
+#include <atomic>
+
 extern void runTests();
 
+// number of calls to the global operator new since startup, see tests.cpp
+extern std::atomic<size_t> allocationCount;
+
 #endif /* tests_hpp */
@@ -33,6 +33,7 @@ int mode_webui(int port) {
 
     std::cout << "Chess AI by Gareth George" << std::endl;
     std::cout << "\tweb interface loading. port: " << port << std::endl;
+    std::cout << "\tslider attacks: " << sliderBackendName(sliderBackend) << std::endl;
 
     //HTTP-server at port 8080 using 4 threads
     HttpServer server(port, 4);
@@ -89,6 +90,17 @@ int mode_webui(int port) {
                 board.setPiece(mailbox64[y * BOARD_DIM + x], piece * team);
             }
 
+            /*
+             the request carries no castling state, so assume the right is
+             kept while the king and rook are still on their home squares
+             */
+            TBoardFlags castling = 0;
+            if (board[mailbox64[4]] == PIECE_KING && board[mailbox64[7]] == PIECE_ROOK) castling |= kFlagCastleWhiteKing;
+            if (board[mailbox64[4]] == PIECE_KING && board[mailbox64[0]] == PIECE_ROOK) castling |= kFlagCastleWhiteQueen;
+            if (board[mailbox64[60]] == -PIECE_KING && board[mailbox64[63]] == -PIECE_ROOK) castling |= kFlagCastleBlackKing;
+            if (board[mailbox64[60]] == -PIECE_KING && board[mailbox64[56]] == -PIECE_ROOK) castling |= kFlagCastleBlackQueen;
+            board.setFlags(castling);
+
             /*
              make a move!
              */